@@ -24,13 +24,80 @@
 
 #include "button_matrix.h"
 
-static int pressed_buttons = 0;
-static bool multiple_event_f = 0;
-static bool long_event_f = 0;
-static bool double_event_f = 0;
-static uint8_t buttons[] = {BM_NULL_BTN, BM_NULL_BTN, BM_NULL_BTN};
+/* Bit of a button (1 based) in a BUTTON_MATRIX_state_t bitmap */
+#define BM_KEY_BIT(button)      ((BUTTON_MATRIX_state_t)1 << ((button) - 1))
+
+static BUTTON_MATRIX_state_t pressed_keys;    /* every button that is held */
+static BUTTON_MATRIX_state_t chord_keys;      /* buttons held after the most recent press */
+static uint8_t pressed_buttons;
+static uint8_t chord_size;
+static uint8_t first_button;                  /* earliest held button, reported as btn1 */
+static uint8_t second_button;                 /* next held button, reported as btn2 */
+static uint8_t last_button;                   /* most recently pressed button */
+static uint32_t chord_time;                   /* when the most recent press completed the chord */
+static bool multiple_event_f;                 /* the current chord was already reported, or is an error */
+static bool long_event_f;
+static uint32_t edge_time;                    /* when the scan confirmed the edge being handled; timers count from it */
+#if CFG_RAW_EVENTS
+static uint32_t press_time[BM_KEY_CODES];     /* when each held button was pressed */
+#endif
+#if CFG_LATENCY_HISTOGRAM
+static uint32_t raw_edge[BM_KEY_CODES];       /* raw edge of the most recent edge of each button */
+static uint32_t latency_onset;                /* raw edge of the edge being handled */
+static bool latency_from_edge;                /* true while the events come from that edge, not from a timer */
+static volatile uint16_t latencyBins[BM_EVENT_TYPES][BM_LATENCY_BINS];
+static volatile uint8_t latencySeq;           /* odd while the histogram is being updated */
+static volatile bool latencyReset;
+#endif
+#if CFG_AUTO_REPEAT
+static uint8_t repeat_button;                 /* held button that repeats, the most recently pressed one */
+static uint32_t repeat_time;                  /* when repeat_button was pressed */
+static uint16_t repeat_interval;              /* ms until the next REPEAT */
+#endif
+#if CFG_MULTI_TAP
+static uint8_t tap_button;                    /* button of the running tap sequence */
+static uint8_t tap_count;                     /* taps so far, 0 while no sequence runs */
+static uint32_t tap_start;                    /* press of the first tap */
+static uint32_t tap_time;                     /* release of the last tap */
+#endif
+#if CFG_DEFERRED_DISPATCH
+#if (CFG_DEFERRED_QUEUE_SIZE < 2) || (CFG_DEFERRED_QUEUE_SIZE > 128) || \
+    ((CFG_DEFERRED_QUEUE_SIZE & (CFG_DEFERRED_QUEUE_SIZE - 1)) != 0)
+#error "CFG_DEFERRED_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+
+/* Compact record of an interrupt that BUTTON_MATRIX_Tasks still has to handle */
+#define BM_DEFERRED_EDGE        0    /* arg1: button, arg2: state, timestamp: when the scan confirmed it, onset: its raw edge */
+#define BM_DEFERRED_TIMER       1    /* arg1: timer slot, arg2: its generation */
+
+typedef struct {
+    uint8_t type;
+    uint8_t arg1;
+    uint8_t arg2;
+    uint32_t timestamp;
+    uint32_t onset;
+} bm_deferred_t;
+
+static bm_ring_t deferredRing;
+static bm_deferred_t deferredBuffer[CFG_DEFERRED_QUEUE_SIZE];
+#endif
 
 bmEvent_cb_t bmEventHandler_TransferEvent_Cb;
+bmRecord_cb_t bmEventHandler_TransferRecord_Cb;
+
+#if CFG_SUBSCRIBERS
+#if CFG_SUBSCRIBERS > 8
+#error "CFG_SUBSCRIBERS must be 8 or less"
+#endif
+
+typedef struct {
+    bmRecord_cb_t callback;         /* NULL while the entry is free */
+    BUTTON_MATRIX_state_t keys;     /* BM_KEYS_ANY, or the keys the subscriber wants */
+} bm_subscriber_t;
+
+static bm_subscriber_t subscribers[CFG_SUBSCRIBERS];
+static volatile uint8_t subscribersOf[BM_EVENT_TYPES];    /* per event type, bit n set when subscriber n wants it */
+#endif
 
 /* Function that sets the transfer event callback */
 void BUTTON_MATRIX_setEventCallback(bmEvent_cb_t function)
@@ -38,108 +105,758 @@ void BUTTON_MATRIX_setEventCallback(bmEvent_cb_t function)
     bmEventHandler_TransferEvent_Cb = function;
 }
 
-/* Callback for TCB0 - will transmit the long button press event */
-void bmEventHandler_timer_Cb(void)
+/* Function that sets the callback that receives the complete event record */
+void BUTTON_MATRIX_setRecordCallback(bmRecord_cb_t function)
 {
-    if(NULL != bmEventHandler_TransferEvent_Cb)
+    bmEventHandler_TransferRecord_Cb = function;
+}
+
+#if CFG_SUBSCRIBERS
+/*
+ * Registers a callback for the event types in events and, unless keys is
+ * BM_KEYS_ANY, only for the events that involve one of keys. Returns the handle
+ * to pass to BUTTON_MATRIX_unsubscribe, or BM_SUBSCRIBER_NONE when the table is
+ * full. The entry is filled before it is published in subscribersOf, so this
+ * may be called while events are being dispatched.
+ */
+uint8_t BUTTON_MATRIX_subscribe(bmRecord_cb_t function, BUTTON_MATRIX_eventMask_t events, BUTTON_MATRIX_state_t keys)
+{
+    uint8_t handle;
+    
+    for(handle = 0; handle < CFG_SUBSCRIBERS; handle++)
     {
-        if(!multiple_event_f && !double_event_f)
+        if(subscribers[handle].callback == NULL)
         {
-            bmEventHandler_TransferEvent_Cb(LONG_PRESS, buttons[0], BM_NULL_BTN);
+            break;
         }
-        else if (double_event_f)
+    }
+    if((handle == CFG_SUBSCRIBERS) || (function == NULL))
+    {
+        return BM_SUBSCRIBER_NONE;
+    }
+    
+    subscribers[handle].keys = keys;
+    subscribers[handle].callback = function;
+    BM_RING_BARRIER();
+    for(uint8_t event = 0; event < BM_EVENT_TYPES; event++)
+    {
+        if(events & BM_EVENT_MASK(event))
         {
-            bmEventHandler_TransferEvent_Cb(MULTIPLE_LONG_PRESS, buttons[0], buttons[1]);
+            subscribersOf[event] |= (uint8_t)(1 << handle);
         }
     }
     
-    long_event_f = 1;
+    return handle;
 }
 
-/* Function that receives the state of a button and transmits the event */
-void BUTTON_MATRIX_EventHandler(uint8_t button, bool state)
+/* Removes a subscriber; it is unpublished before its entry is freed */
+void BUTTON_MATRIX_unsubscribe(uint8_t handle)
 {
-    if(state == BM_BUTTON_PRESSED)
+    if(handle >= CFG_SUBSCRIBERS)
+    {
+        return;
+    }
+    
+    for(uint8_t event = 0; event < BM_EVENT_TYPES; event++)
+    {
+        subscribersOf[event] &= (uint8_t)~(1 << handle);
+    }
+    BM_RING_BARRIER();
+    subscribers[handle].callback = NULL;
+}
+
+/* Calls only the subscribers of this event type, then checks their key masks */
+static void bmEventHandler_notify(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    uint8_t pending = subscribersOf[record->event];
+    uint8_t handle = 0;
+    
+    while(pending != 0)
     {
-        switch(pressed_buttons)
-        {
-            case 0:
-                RTC_Start();
-                buttons[pressed_buttons] = button;
-                pressed_buttons++;
-                multiple_event_f = 0;
-                double_event_f = 0;
-                long_event_f = 0;
-                break;
-            case 1:
-                RTC_Start();
-                buttons[pressed_buttons] = button;
-                pressed_buttons++;
-                multiple_event_f = 0;
-                double_event_f = 1;
-                long_event_f = 0;
-                break;
-            case 2:
-                RTC_Stop();
-                if(NULL != bmEventHandler_TransferEvent_Cb)
-                {
-                    bmEventHandler_TransferEvent_Cb(ERROR, BM_NULL_BTN, BM_NULL_BTN);
-                }
-                buttons[pressed_buttons] = button;
-                pressed_buttons++;
-                multiple_event_f = 1;
-                double_event_f = 0;
-                long_event_f = 0;
-                break;
-            default:
-                multiple_event_f = 1;
-                break;
+        if(pending & 1)
+        {
+            if((subscribers[handle].keys == BM_KEYS_ANY) || (subscribers[handle].keys & record->keys))
+            {
+                subscribers[handle].callback(record);
+            }
         }
+        pending >>= 1;
+        handle++;
     }
-    else if(state == BM_BUTTON_RELEASED)
+}
+#endif
+
+#if CFG_LATENCY_HISTOGRAM
+/*
+ * Counts the delay from the raw edge that produced the event to the callbacks
+ * in the log2 bin of its length in ms. That is the edge being handled, or
+ * for a timer event the most recent edge of btn1. The sequence counter is odd while the bins
+ * change, so a reader in another context retries instead of masking the scan.
+ */
+static void bmEventHandler_latency(BUTTON_MATRIX_event_t event, uint8_t btn1)
+{
+    uint32_t onset = latency_onset;
+    uint16_t ms;
+    uint8_t bin = 0;
+    
+    if((btn1 == BM_NULL_BTN) || (btn1 > BM_KEY_CODES))
     {
-        RTC_Stop();
-        if((!long_event_f) && (!multiple_event_f))
+        return;
+    }
+    
+    if(!latency_from_edge)
+    {
+        onset = raw_edge[btn1 - 1];
+    }
+    ms = bmTimer_toMs(bmTimer_now() - onset);
+    while((ms != 0) && (bin < (BM_LATENCY_BINS - 1)))
+    {
+        ms >>= 1;
+        bin++;
+    }
+    
+    latencySeq++;
+    BM_RING_BARRIER();
+    if(latencyReset)
+    {
+        latencyReset = false;
+        for(uint8_t i = 0; i < BM_EVENT_TYPES; i++)
         {
-            if(NULL != bmEventHandler_TransferEvent_Cb)
+            for(uint8_t j = 0; j < BM_LATENCY_BINS; j++)
             {
-                if(double_event_f)
-                {
-                    multiple_event_f = 1;
-                    bmEventHandler_TransferEvent_Cb(MULTIPLE_SHORT_PRESS, buttons[0], buttons[1]);
-                }
-                else
-                    bmEventHandler_TransferEvent_Cb(SHORT_PRESS, buttons[pressed_buttons - 1], BM_NULL_BTN);
+                latencyBins[i][j] = 0;
             }
         }
+    }
+    if(latencyBins[event][bin] != UINT16_MAX)
+    {
+        latencyBins[event][bin]++;
+    }
+    BM_RING_BARRIER();
+    latencySeq++;
+}
+#endif
+
+/* Queues the event for the main loop and notifies the user callbacks, if any */
+static void bmEventHandler_dispatch(BUTTON_MATRIX_event_t event, uint8_t btn1, uint8_t btn2, BUTTON_MATRIX_state_t keys, uint32_t timestamp, uint16_t duration, uint8_t count)
+{
+    BUTTON_MATRIX_eventRecord_t record;
+    
+    record.event = event;
+    record.btn1 = btn1;
+    record.btn2 = btn2;
+    record.keys = keys;
+    record.timestamp = timestamp;
+    record.duration = duration;
+    record.count = count;
+    bmEventQueue_push(&record);
+    
+#if CFG_LATENCY_HISTOGRAM
+    bmEventHandler_latency(event, btn1);
+#endif
+    BM_PROFILE_BEGIN();
+    if(NULL != bmEventHandler_TransferEvent_Cb)
+    {
+        bmEventHandler_TransferEvent_Cb(event, btn1, btn2);
+    }
+    if(NULL != bmEventHandler_TransferRecord_Cb)
+    {
+        bmEventHandler_TransferRecord_Cb(&record);
+    }
+#if CFG_SUBSCRIBERS
+    bmEventHandler_notify(&record);
+#endif
+    BM_PROFILE_END(BM_PROFILE_CALLBACK);
+    
+#if CFG_SEQUENCE_RECOGNIZER
+    /* Short presses and short chords are the steps of the patterns; a long press or an error breaks a sequence */
+    if((event == SHORT_PRESS) || (event == MULTIPLE_SHORT_PRESS))
+    {
+        uint32_t start;
+        uint8_t id = bmSequence_step(keys, timestamp, &start);
         
-        for(int i = 0; i < pressed_buttons; i++)
+        if(id != BM_SEQUENCE_NO_MATCH)
         {
-            if(buttons[i] == button)
+            bmEventHandler_dispatch(SEQUENCE, BM_NULL_BTN, BM_NULL_BTN, keys, timestamp, bmTimer_toMs(timestamp - start), id);
+        }
+    }
+    else if((event == LONG_PRESS) || (event == MULTIPLE_LONG_PRESS) || (event == ERROR))
+    {
+        bmSequence_reset();
+    }
+#endif
+}
+
+/* Lowest numbered button in keys; only used when btn2 has to be refilled */
+static uint8_t bmEventHandler_lowestButton(BUTTON_MATRIX_state_t keys)
+{
+    uint8_t button = 1;
+    
+    while(!(keys & 0x01))
+    {
+        keys >>= 1;
+        button++;
+    }
+    
+    return button;
+}
+
+#if CFG_MULTI_TAP
+/* Event that sums up a tap sequence of count taps */
+static BUTTON_MATRIX_event_t bmEventHandler_tapEvent(uint8_t count)
+{
+    if(count == 1)
+    {
+        return SHORT_PRESS;
+    }
+    return (count == 2) ? DOUBLE_TAP : N_TAP;
+}
+
+/* Ends the tap sequence; a button in CFG_TAP_DELAY_KEYS reports it only now, as one event */
+static void bmEventHandler_tapEnd(void)
+{
+    if(tap_count == 0)
+    {
+        return;
+    }
+    
+    bmTimer_stop(BM_TIMER_SLOT_TAP);
+    if((BUTTON_MATRIX_state_t)(CFG_TAP_DELAY_KEYS) & BM_KEY_BIT(tap_button))
+    {
+        bmEventHandler_dispatch(bmEventHandler_tapEvent(tap_count), tap_button, BM_NULL_BTN, BM_KEY_BIT(tap_button), tap_time, bmTimer_toMs(tap_time - tap_start), tap_count);
+    }
+    tap_count = 0;
+    tap_button = BM_NULL_BTN;
+}
+
+/* Tap window timer callback - no new tap came in CFG_TAP_WINDOW */
+static void bmEventHandler_tap_Cb(uint8_t button)
+{
+    bmEventHandler_tapEnd();
+}
+
+/* A press of the tapped button holds the window open, a press of any other button ends the sequence */
+static void bmEventHandler_tapPress(uint8_t button)
+{
+    if(button == tap_button)
+    {
+        bmTimer_stop(BM_TIMER_SLOT_TAP);
+    }
+    else
+    {
+        bmEventHandler_tapEnd();
+    }
+}
+
+/*
+ * Counts a short press of a single button as a tap, pressed at start and released at now
+ * Buttons outside CFG_TAP_DELAY_KEYS report every tap as SHORT_PRESS at once,
+ * followed by DOUBLE_TAP or N_TAP from the second tap on.
+ */
+static void bmEventHandler_tap(uint8_t button, uint32_t start, uint32_t now)
+{
+    if((tap_count != 0) && (button == tap_button))
+    {
+        if(tap_count < UINT8_MAX)
+        {
+            tap_count++;
+        }
+    }
+    else
+    {
+        bmEventHandler_tapEnd();
+        tap_button = button;
+        tap_count = 1;
+        tap_start = start;
+    }
+    tap_time = now;
+    
+    if(!((BUTTON_MATRIX_state_t)(CFG_TAP_DELAY_KEYS) & BM_KEY_BIT(button)))
+    {
+        bmEventHandler_dispatch(SHORT_PRESS, button, BM_NULL_BTN, BM_KEY_BIT(button), now, bmTimer_toMs(now - start), tap_count);
+        if(tap_count >= 2)
+        {
+            bmEventHandler_dispatch(bmEventHandler_tapEvent(tap_count), button, BM_NULL_BTN, BM_KEY_BIT(button), now, bmTimer_toMs(now - tap_start), tap_count);
+        }
+    }
+    bmTimer_startAt(BM_TIMER_SLOT_TAP, edge_time, BM_TIMER_MS(CFG_TAP_WINDOW), bmEventHandler_tap_Cb, button);
+}
+#endif
+
+/* Reports the current chord, held since chord_time; a single button is a plain short or long press */
+static void bmEventHandler_reportChord(bool long_press, uint32_t now)
+{
+    uint16_t duration = bmTimer_toMs(now - chord_time);
+    
+#if CFG_MULTI_TAP
+    if((chord_size == 1) && !long_press)
+    {
+        bmEventHandler_tap(first_button, chord_time, now);
+        return;
+    }
+    /* Anything but a single short press ends the tap sequence first */
+    bmEventHandler_tapEnd();
+#endif
+    
+    if(chord_size == 1)
+    {
+        bmEventHandler_dispatch(long_press ? LONG_PRESS : SHORT_PRESS, first_button, BM_NULL_BTN, chord_keys, now, duration, 0);
+    }
+    else
+    {
+        bmEventHandler_dispatch(long_press ? MULTIPLE_LONG_PRESS : MULTIPLE_SHORT_PRESS, first_button, second_button, chord_keys, now, duration, 0);
+    }
+}
+
+/*
+ * Long-press timer callback - every pressed button has its own deadline
+ * Only the deadline of the most recent press reports an event, and only
+ * while every button of that chord is still held.
+ */
+static void bmEventHandler_timer_Cb(uint8_t button)
+{
+    if(!multiple_event_f && (button == last_button) && (pressed_keys == chord_keys))
+    {
+        bmEventHandler_reportChord(true, bmTimer_deadline(BM_TIMER_SLOT_LONG_PRESS(button)));
+        long_event_f = 1;
+    }
+}
+
+#if CFG_AUTO_REPEAT
+/*
+ * Auto-repeat timer callback - reports REPEAT and rearms the repeat slot
+ * The interval shrinks by CFG_REPEAT_ACCELERATION after each repeat, down to
+ * CFG_REPEAT_MIN_INTERVAL. duration is the time the button has been held.
+ */
+static void bmEventHandler_repeat_Cb(uint8_t button)
+{
+    uint32_t now = bmTimer_deadline(BM_TIMER_SLOT_REPEAT);
+    
+    if(button != repeat_button)
+    {
+        return;
+    }
+    
+    bmEventHandler_dispatch(REPEAT, button, BM_NULL_BTN, pressed_keys, now, bmTimer_toMs(now - repeat_time), 0);
+    bmTimer_restart(BM_TIMER_SLOT_REPEAT, BM_TIMER_MS(repeat_interval));
+    
+    if(repeat_interval >= CFG_REPEAT_MIN_INTERVAL + CFG_REPEAT_ACCELERATION)
+    {
+        repeat_interval -= CFG_REPEAT_ACCELERATION;
+    }
+    else
+    {
+        repeat_interval = CFG_REPEAT_MIN_INTERVAL;
+    }
+}
+
+/* Only the most recently pressed button repeats; its release stops the repeat */
+static void bmEventHandler_repeat(uint8_t button, bool state, uint32_t now)
+{
+    if(state == BM_BUTTON_PRESSED)
+    {
+        repeat_button = button;
+        repeat_time = now;
+        repeat_interval = CFG_REPEAT_INTERVAL;
+        bmTimer_startAt(BM_TIMER_SLOT_REPEAT, edge_time, BM_TIMER_MS(CFG_REPEAT_DELAY), bmEventHandler_repeat_Cb, button);
+    }
+    else if(button == repeat_button)
+    {
+        bmTimer_stop(BM_TIMER_SLOT_REPEAT);
+        repeat_button = BM_NULL_BTN;
+    }
+}
+#endif
+
+/*
+ * Composite event classifier, fed with the debounced edges
+ * Up to CFG_MAX_CHORD_KEYS buttons form a chord; pressing one more reports
+ * ERROR and mutes the chord. pressed_keys already includes the edge.
+ */
+static void bmEventHandler_classify(uint8_t button, bool state, uint32_t now)
+{
+    if(state == BM_BUTTON_PRESSED)
+    {
+        pressed_buttons++;
+        
+        if(first_button == BM_NULL_BTN)
+        {
+            first_button = button;
+        }
+        else if(second_button == BM_NULL_BTN)
+        {
+            second_button = button;
+        }
+        
+        if(pressed_buttons <= CFG_MAX_CHORD_KEYS)
+        {
+            bmTimer_startAt(BM_TIMER_SLOT_LONG_PRESS(button), edge_time, BM_TIMER_MS(CFG_LONG_PRESS_TIME), bmEventHandler_timer_Cb, button);
+            chord_keys = pressed_keys;
+            chord_size = pressed_buttons;
+            chord_time = now;
+            last_button = button;
+            multiple_event_f = 0;
+            long_event_f = 0;
+        }
+        else
+        {
+            if(pressed_buttons == CFG_MAX_CHORD_KEYS + 1)
             {
-                for(int j = i; j < pressed_buttons - 1; j++)
-                {
-                    buttons[j] = buttons[j + 1];
-                }
-                buttons[pressed_buttons - 1] = BM_NULL_BTN;
-                pressed_buttons--;
+                bmEventHandler_dispatch(ERROR, BM_NULL_BTN, BM_NULL_BTN, pressed_keys, now, 0, 0);
             }
+            multiple_event_f = 1;
+        }
+    }
+    else
+    {
+        bmTimer_stop(BM_TIMER_SLOT_LONG_PRESS(button));
+        if((!long_event_f) && (!multiple_event_f))
+        {
+            bmEventHandler_reportChord(false, now);
+            multiple_event_f = 1;
+        }
+        
+        pressed_buttons--;
+        
+        if(button == first_button)
+        {
+            first_button = second_button;
+            second_button = BM_NULL_BTN;
+        }
+        else if(button == second_button)
+        {
+            second_button = BM_NULL_BTN;
+        }
+        if((second_button == BM_NULL_BTN) && (pressed_buttons >= 2))
+        {
+            second_button = bmEventHandler_lowestButton(pressed_keys & ~BM_KEY_BIT(first_button));
+        }
+    }
+}
+
+/*
+ * Applies a debounced edge of a button that left its previous level at now
+ * Held buttons are tracked as a bitmap, so a press or a release costs the
+ * same whatever the number of held buttons. With CFG_RAW_EVENTS the edge is
+ * reported as PRESS or RELEASE right away, before the classifier sees it.
+ */
+static void bmEventHandler_applyEdge(uint8_t button, bool state, uint32_t now)
+{
+    BUTTON_MATRIX_state_t key = BM_KEY_BIT(button);
+    
+    if(state == BM_BUTTON_PRESSED)
+    {
+        if(pressed_keys & key)
+        {
+            return;
+        }
+        pressed_keys |= key;
+#if CFG_RAW_EVENTS
+        press_time[button - 1] = now;
+        bmEventHandler_dispatch(PRESS, button, BM_NULL_BTN, pressed_keys, now, 0, 0);
+#endif
+#if CFG_MULTI_TAP
+        bmEventHandler_tapPress(button);
+#endif
+    }
+    else if(state == BM_BUTTON_RELEASED)
+    {
+        if(!(pressed_keys & key))
+        {
+            return;
+        }
+        pressed_keys &= ~key;
+#if CFG_RAW_EVENTS
+        bmEventHandler_dispatch(RELEASE, button, BM_NULL_BTN, pressed_keys, now, bmTimer_toMs(now - press_time[button - 1]), 0);
+#endif
+    }
+    else
+    {
+        return;
+    }
+    
+    bmEventHandler_classify(button, state, now);
+#if CFG_AUTO_REPEAT
+    bmEventHandler_repeat(button, state, now);
+#endif
+}
+
+/*
+ * Handles a debounced edge of a button, confirmed by the scan at confirm_time.
+ * The events report onset, when the scan saw the button leave its previous
+ * level; the timers count from confirm_time.
+ */
+static void bmEventHandler_edge(uint8_t button, bool state, uint32_t confirm_time, uint32_t onset)
+{
+    edge_time = confirm_time;
+#if CFG_LATENCY_HISTOGRAM
+    if((button != BM_NULL_BTN) && (button <= BM_KEY_CODES))
+    {
+        raw_edge[button - 1] = onset;
+    }
+    latency_onset = onset;
+    latency_from_edge = true;
+#endif
+    bmEventHandler_applyEdge(button, state, onset);
+#if CFG_LATENCY_HISTOGRAM
+    latency_from_edge = false;
+#endif
+}
+
+#if CFG_DEFERRED_DISPATCH
+/* Called from interrupt context: only records what happened, for BUTTON_MATRIX_Tasks */
+static void bmEventHandler_defer(uint8_t type, uint8_t arg1, uint8_t arg2, uint32_t timestamp, uint32_t onset)
+{
+    uint8_t slot = bmRing_writeSlot(&deferredRing);
+    
+    if(slot == BM_RING_NO_SLOT)
+    {
+        return;
+    }
+    
+    deferredBuffer[slot].type = type;
+    deferredBuffer[slot].arg1 = arg1;
+    deferredBuffer[slot].arg2 = arg2;
+    deferredBuffer[slot].timestamp = timestamp;
+    deferredBuffer[slot].onset = onset;
+    bmRing_publish(&deferredRing);
+}
+
+/* RTC interrupt: a timer expired, its callback runs later in BUTTON_MATRIX_Tasks */
+static void bmEventHandler_timerExpired(uint8_t slot, uint8_t generation)
+{
+    bmEventHandler_defer(BM_DEFERRED_TIMER, slot, generation, 0, 0);
+}
+#endif
+
+/*
+ * Function that receives the debounced state of a button from the scan interrupt
+ * With CFG_DEFERRED_DISPATCH the edge is only recorded, and classified later by
+ * BUTTON_MATRIX_Tasks; otherwise it is classified here, in interrupt context.
+ */
+void BUTTON_MATRIX_EventHandler(uint8_t button, bool state)
+{
+    uint32_t now = bmTimer_now();
+    uint32_t onset = now;
+    
+    /* Edges that do not come from the scan have no raw edge, they happened now */
+    if(!buttonMatrixPhy_getRawEdge(&onset))
+    {
+        onset = now;
+    }
+#if CFG_DEFERRED_DISPATCH
+    bmEventHandler_defer(BM_DEFERRED_EDGE, button, state, now, onset);
+#else
+    /* The timers the edge starts and stops cost one compare write, not one each */
+    bmTimer_hold();
+    bmEventHandler_edge(button, state, now, onset);
+    bmTimer_release();
+#endif
+}
+
+/*
+ * Classifies the recorded edges and runs the expired timers, in the order the
+ * interrupts recorded them, so the callbacks run in the caller's context.
+ * With CFG_IDLE_WAKEUP it also restarts the scan after a row pin change woke
+ * the CPU up; call it from the main loop.
+ */
+void BUTTON_MATRIX_Tasks(void)
+{
+#if CFG_IDLE_WAKEUP
+    buttonMatrixPhy_tasks();
+#endif
+#if CFG_DEFERRED_DISPATCH
+    bm_deferred_t record;
+    uint8_t slot;
+    
+    while((slot = bmRing_readSlot(&deferredRing)) != BM_RING_NO_SLOT)
+    {
+        record = deferredBuffer[slot];
+        bmRing_release(&deferredRing);
+        
+        if(record.type == BM_DEFERRED_EDGE)
+        {
+            bmEventHandler_edge(record.arg1, record.arg2, record.timestamp, record.onset);
+        }
+        else
+        {
+            bmTimer_run(record.arg1, record.arg2);
+        }
+    }
+#endif
+}
+
+/* True while BUTTON_MATRIX_Tasks has recorded interrupts or a row wake-up to handle */
+bool BUTTON_MATRIX_tasksPending(void)
+{
+#if CFG_IDLE_WAKEUP
+    if(buttonMatrixPhy_wakePending())
+    {
+        return true;
+    }
+#endif
+#if CFG_DEFERRED_DISPATCH
+    return deferredRing.head != deferredRing.tail;
+#else
+    return false;
+#endif
+}
+
+/* Monotonic time base of the event timestamps, in RTC ticks (1/32768 s); wraps after 36.4 hours */
+uint32_t BUTTON_MATRIX_getTime(void)
+{
+    return bmTimer_now();
+}
+
+/* Returns true when at least one event is waiting in the queue */
+bool BUTTON_MATRIX_poll(void)
+{
+    return bmEventQueue_pending();
+}
+
+/* Copies the oldest queued event into record; returns false when there is none */
+bool BUTTON_MATRIX_getEvent(BUTTON_MATRIX_eventRecord_t *record)
+{
+    return bmEventQueue_pop(record);
+}
+
+/* Copies up to max queued events into buffer and returns how many were copied */
+uint8_t BUTTON_MATRIX_readEvents(BUTTON_MATRIX_eventRecord_t *buffer, uint8_t max)
+{
+    return bmEventQueue_read(buffer, max);
+}
+
+/* Number of events lost because the queue was full, or because the deferred records overflowed */
+uint16_t BUTTON_MATRIX_getDroppedEvents(void)
+{
+#if CFG_DEFERRED_DISPATCH
+    return bmEventQueue_getDrops() + bmRing_getDrops(&deferredRing);
+#else
+    return bmEventQueue_getDrops();
+#endif
+}
+
+/* Largest number of events that were waiting in the queue at the same time */
+uint8_t BUTTON_MATRIX_getQueueHighWater(void)
+{
+    return bmEventQueue_getHighWater();
+}
+
+/* Keys that are pressed right now, bit (key - 1) set per pressed key */
+BUTTON_MATRIX_state_t BUTTON_MATRIX_getState(void)
+{
+    return buttonMatrixPhy_getState();
+}
+
+#if CFG_IDLE_WAKEUP
+/* True while the scan is stopped and the rows wait for a pin change */
+bool BUTTON_MATRIX_isIdle(void)
+{
+    return buttonMatrixPhy_isIdle();
+}
+
+/* Number of times the scan went idle, and number of times a row pin change woke it up */
+void BUTTON_MATRIX_getIdleStats(uint16_t *entries, uint16_t *wakeups)
+{
+    buttonMatrixPhy_getIdleStats(entries, wakeups);
+}
+#endif
+
+#if CFG_LATENCY_HISTOGRAM
+/*
+ * Copies the latency bins of one event type; false for an unknown type
+ * Bin 0 counts the callbacks within 1 ms of the raw edge of btn1, bin n
+ * those from 2^(n-1) to 2^n - 1 ms, and the last bin everything longer.
+ */
+bool BUTTON_MATRIX_getLatencyHistogram(uint8_t event, uint16_t *bins)
+{
+    uint8_t seq;
+    bool reset;
+    
+    if(event >= BM_EVENT_TYPES)
+    {
+        return false;
+    }
+    
+    do
+    {
+        seq = latencySeq;
+        BM_RING_BARRIER();
+        reset = latencyReset;
+        for(uint8_t i = 0; i < BM_LATENCY_BINS; i++)
+        {
+            bins[i] = latencyBins[event][i];
+        }
+        BM_RING_BARRIER();
+    } while((seq & 0x01) || (seq != latencySeq));
+    
+    /* A reset is applied by the next event; until then the histogram reads empty */
+    if(reset)
+    {
+        for(uint8_t i = 0; i < BM_LATENCY_BINS; i++)
+        {
+            bins[i] = 0;
         }
     }
     
+    return true;
+}
+
+/* Empties every bin; the scan keeps running and the next event clears them */
+void BUTTON_MATRIX_resetLatencyHistogram(void)
+{
+    latencyReset = true;
+}
+#endif
+
+#if CFG_SCAN_LATENCY_PROBE
+/* Smallest and largest scan interrupt entry latency seen so far, in CPU cycles */
+void BUTTON_MATRIX_getScanLatency(uint16_t *min, uint16_t *max)
+{
+    buttonMatrixPhy_getScanLatency(min, max);
 }
 
-/* Function that initializes the buttons array, and sets necessary ISR callback functions */
+void BUTTON_MATRIX_resetScanLatency(void)
+{
+    buttonMatrixPhy_resetScanLatency();
+}
+#endif
+
+/* Function that initializes the classifier state, and sets necessary ISR callback functions */
 void BUTTON_MATRIX_init(void)
 {
+    pressed_keys = 0;
+    chord_keys = 0;
     pressed_buttons = 0;
+    chord_size = 0;
+    first_button = BM_NULL_BTN;
+    second_button = BM_NULL_BTN;
+    last_button = BM_NULL_BTN;
+    chord_time = 0;
     multiple_event_f = 0;
     long_event_f = 0;
-    double_event_f = 0;
-    buttons[0] = BM_NULL_BTN;
-    buttons[1] = BM_NULL_BTN;
-    buttons[2] = BM_NULL_BTN;
+#if CFG_AUTO_REPEAT
+    repeat_button = BM_NULL_BTN;
+#endif
+#if CFG_MULTI_TAP
+    tap_button = BM_NULL_BTN;
+    tap_count = 0;
+#endif
+#if CFG_SEQUENCE_RECOGNIZER
+    bmSequence_reset();
+#endif
+#if CFG_KEYMAP
+    bmKeymap_init();
+#endif
     
-    RTC_SetOVFIsrCallback(bmEventHandler_timer_Cb);
+#if CFG_PROFILER
+    bmProfile_init();
+#endif
+    bmEventQueue_init();
+    bmTimer_init();
+#if CFG_DEFERRED_DISPATCH
+    bmRing_init(&deferredRing, CFG_DEFERRED_QUEUE_SIZE);
+    bmTimer_setExpiredHandler(bmEventHandler_timerExpired);
+#endif
     buttonMatrixPhy_init();
-}
\ No newline at end of file
+}
@@ -23,6 +23,11 @@
 #define	BM_EVENT_HANDLER_H
 
 #include "button_matrix_phy.h"
+#include "button_matrix_queue.h"
+#include "button_matrix_timer.h"
+#include "button_matrix_sequence.h"
+#include "button_matrix_keymap.h"
+#include "button_matrix_profile.h"
 
 typedef enum {
     NONE,
@@ -30,14 +35,70 @@ typedef enum {
     SHORT_PRESS,
     LONG_PRESS,
     MULTIPLE_SHORT_PRESS,
-    MULTIPLE_LONG_PRESS
+    MULTIPLE_LONG_PRESS,
+    PRESS,              /* debounced press edge, only with CFG_RAW_EVENTS */
+    RELEASE,            /* debounced release edge, only with CFG_RAW_EVENTS */
+    REPEAT,             /* held button repeats, only with CFG_AUTO_REPEAT */
+    DOUBLE_TAP,         /* second short press of the same button, only with CFG_MULTI_TAP */
+    N_TAP,              /* third or later short press of the same button, count holds the taps */
+    SEQUENCE            /* a pattern of the sequence table was entered, count holds its id */
 } BUTTON_MATRIX_event_t;
 
+#define BM_EVENT_TYPES          (SEQUENCE + 1)
+
+/* Event type bitmaps used to filter the events a subscriber receives */
+typedef uint16_t BUTTON_MATRIX_eventMask_t;
+#define BM_EVENT_MASK(event)    ((BUTTON_MATRIX_eventMask_t)1 << (event))
+#define BM_EVENT_MASK_ALL       ((BUTTON_MATRIX_eventMask_t)((1UL << BM_EVENT_TYPES) - 1))
+#define BM_KEYS_ANY             ((BUTTON_MATRIX_state_t)0)    /* key mask of a subscriber that wants every key */
+#define BM_SUBSCRIBER_NONE      0xFF
+
 typedef void (*bmEvent_cb_t)(uint8_t event, uint8_t btn1, uint8_t btn2);
+typedef void (*bmRecord_cb_t)(const BUTTON_MATRIX_eventRecord_t *record);
 
 void BUTTON_MATRIX_init(void);
 void BUTTON_MATRIX_EventHandler(uint8_t button, bool state);
+void BUTTON_MATRIX_Tasks(void);
+bool BUTTON_MATRIX_tasksPending(void);
 void BUTTON_MATRIX_setEventCallback(bmEvent_cb_t function);
+void BUTTON_MATRIX_setRecordCallback(bmRecord_cb_t function);
+
+#if CFG_SUBSCRIBERS
+uint8_t BUTTON_MATRIX_subscribe(bmRecord_cb_t function, BUTTON_MATRIX_eventMask_t events, BUTTON_MATRIX_state_t keys);
+void BUTTON_MATRIX_unsubscribe(uint8_t handle);
+#endif
+uint32_t BUTTON_MATRIX_getTime(void);
+
+/* Event handoff to the main loop; none of these functions disable interrupts */
+bool BUTTON_MATRIX_poll(void);
+bool BUTTON_MATRIX_getEvent(BUTTON_MATRIX_eventRecord_t *record);
+uint8_t BUTTON_MATRIX_readEvents(BUTTON_MATRIX_eventRecord_t *buffer, uint8_t max);
+uint16_t BUTTON_MATRIX_getDroppedEvents(void);
+uint8_t BUTTON_MATRIX_getQueueHighWater(void);
+
+/*
+ * Consistent snapshot of the debounced keys, without disabling interrupts
+ * Bit (n - 1) is the physical button Sn, also with CFG_KEYMAP: the snapshot is
+ * taken before the keymap, while the events, the subscriber key masks and the
+ * sequence steps use key codes. Do not mix the two numberings.
+ */
+BUTTON_MATRIX_state_t BUTTON_MATRIX_getState(void);
+
+#if CFG_IDLE_WAKEUP
+bool BUTTON_MATRIX_isIdle(void);
+void BUTTON_MATRIX_getIdleStats(uint16_t *entries, uint16_t *wakeups);
+#endif
+
+#if CFG_LATENCY_HISTOGRAM
+#define BM_LATENCY_BINS         14    /* log2 bins in ms: under 1 ms, 1 ms, 2..3 ms, ... 4096 ms and longer */
+bool BUTTON_MATRIX_getLatencyHistogram(uint8_t event, uint16_t *bins);
+void BUTTON_MATRIX_resetLatencyHistogram(void);
+#endif
+
+#if CFG_SCAN_LATENCY_PROBE
+void BUTTON_MATRIX_getScanLatency(uint16_t *min, uint16_t *max);
+void BUTTON_MATRIX_resetScanLatency(void);
+#endif
 
 #ifdef	__cplusplus
 extern "C" {
@@ -25,6 +25,40 @@
 #define CFG_COLUMNS              4
 #define CFG_ROWS                 4
 #define CFG_DEBOUNCE_TIME        4    /* 4 * 20 ms */
+#define CFG_DEBOUNCE_PRESS_TIME  CFG_DEBOUNCE_TIME   /* scans a press must be stable; 1 reports the first pressed sample */
+#define CFG_DEBOUNCE_RELEASE_TIME CFG_DEBOUNCE_TIME  /* scans a release must be stable */
+#define CFG_DEBOUNCE_LOCKOUT     0    /* scans a button ignores its row after a press is reported */
+#define CFG_MAX_CHORD_KEYS       2    /* buttons that may be held together; one more reports ERROR */
+#define CFG_LONG_PRESS_TIME      2000 /* ms a button must be held to report a long press */
+#define CFG_AUTO_REPEAT          0    /* 1: report REPEAT events while the last pressed button is held */
+#define CFG_REPEAT_DELAY         500  /* ms from the press to the first REPEAT */
+#define CFG_REPEAT_INTERVAL      100  /* ms between the first REPEAT events */
+#define CFG_REPEAT_ACCELERATION  10   /* ms the interval shrinks after each REPEAT; 0 keeps a fixed rate */
+#define CFG_REPEAT_MIN_INTERVAL  30   /* ms, shortest interval reached by the acceleration */
+#define CFG_MULTI_TAP            0    /* 1: report DOUBLE_TAP and N_TAP for repeated short presses of one button */
+#define CFG_TAP_WINDOW           300  /* ms from a release to the next press of the same tap sequence */
+#define CFG_TAP_DELAY_KEYS       0x0000   /* buttons (bit n - 1 for Sn) whose taps are only reported when the window ends */
+#define CFG_SEQUENCE_RECOGNIZER  0    /* 1: report SEQUENCE when a pattern of the sequence table is entered */
+#define CFG_SEQUENCE_MAX_STEPS   4    /* longest pattern of the sequence table */
+#define CFG_SEQUENCE_TIMEOUT     2000 /* ms allowed between two steps of a pattern */
+#define CFG_KEYMAP               0    /* 1: map the physical keys to key codes through a layered keymap */
+#define CFG_KEYMAP_CODES         32   /* key codes 1 to N reported through the keymap, up to 32 */
+#define CFG_DEBOUNCE_ALGORITHM   BM_DEBOUNCE_COUNTER   /* BM_DEBOUNCE_COUNTER or BM_DEBOUNCE_VERTICAL */
+#define CFG_EVENT_QUEUE_SIZE     16   /* power of two, 2 to 128 events */
+#define CFG_RAW_EVENTS           0    /* 1: also report every debounced edge as PRESS or RELEASE */
+#define CFG_DEFERRED_DISPATCH    0    /* 1: interrupts only record edges and timer expiries, BUTTON_MATRIX_Tasks classifies them */
+#define CFG_DEFERRED_QUEUE_SIZE  16   /* power of two, 2 to 128 records waiting for BUTTON_MATRIX_Tasks */
+#define CFG_SUBSCRIBERS          0    /* 0 to 8 entries of the subscriber table, each with its own event and key masks */
+#define CFG_IDLE_WAKEUP          0    /* 1: stop the scan while no key is held, BUTTON_MATRIX_Tasks restarts it after a row pin change */
+#define CFG_SCAN_LATENCY_PROBE   0    /* 1: measure scan ISR entry latency with TCB0 */
+#define CFG_MAIN_ATOMIC_POLL     0    /* 1: demo runs the original ATOMIC_BLOCK polling loop, to compare the scan ISR latency */
+#define CFG_LATENCY_HISTOGRAM    0    /* 1: log2 histogram per event type of the time from the raw edge of btn1 to the callbacks */
+#define CFG_PROFILER             0    /* 1: time the scan ISR, the RTC ISR and the event callbacks with TCB1 */
+#define CFG_PROFILER_DUMP_S      10   /* demo prints and restarts the profile at most this often, 1 to 120 s */
+#define CFG_EVENT_OUTPUT_BINARY  0    /* 1: demo sends COBS framed binary events instead of text */
+#define CFG_MAIN_SLEEP_MODE      SLEEP_MODE_NONE       /* SLEEP_MODE_NONE, SLEEP_MODE_IDLE or SLEEP_MODE_STANDBY */
+#define CFG_SLEEP_STATS          0    /* 1: measure the share of time the main loop sleeps */
+#define CFG_SLEEP_STATS_PERIOD   RTC_PERIOD_CYC512_gc  /* sampling period: 512 / 32768 Hz = 15.6 ms */
 
 /*
  * Pin Mapping (in order):
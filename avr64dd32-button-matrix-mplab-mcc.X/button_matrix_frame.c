@@ -0,0 +1,160 @@
+/**
+ * \file button_matrix_frame.c
+ *
+ * \brief Button Matrix binary event framing (COBS + CRC-8).
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix_frame.h"
+
+static uint32_t frameTime;              /* RTC time the receiver has rebuilt from the frames sent so far */
+
+/* CRC-8 with polynomial x^8 + x^2 + x + 1 (0x07), one byte at a time */
+uint8_t bmFrame_crc8(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        if(crc & 0x80)
+        {
+            crc = (crc << 1) ^ 0x07;
+        }
+        else
+        {
+            crc <<= 1;
+        }
+    }
+    
+    return crc;
+}
+
+/*
+ * Consistent Overhead Byte Stuffing of up to 253 bytes.
+ * Returns the encoded length, which is always length + 1.
+ */
+uint8_t bmFrame_cobsEncode(const uint8_t *source, uint8_t length, uint8_t *destination)
+{
+    uint8_t code_index = 0;
+    uint8_t write_index = 1;
+    uint8_t code = 1;
+    
+    for(uint8_t i = 0; i < length; i++)
+    {
+        if(source[i] == 0)
+        {
+            destination[code_index] = code;
+            code_index = write_index++;
+            code = 1;
+        }
+        else
+        {
+            destination[write_index++] = source[i];
+            code++;
+        }
+    }
+    destination[code_index] = code;
+    
+    return write_index;
+}
+
+/* Bitmap of the keys a delta frame implies: btn1 and btn2 */
+static BUTTON_MATRIX_state_t bmFrame_impliedKeys(uint8_t btn1, uint8_t btn2)
+{
+    BUTTON_MATRIX_state_t keys = 0;
+    
+    if(btn1 != 0)
+    {
+        keys |= (BUTTON_MATRIX_state_t)1 << (btn1 - 1);
+    }
+    if(btn2 != 0)
+    {
+        keys |= (BUTTON_MATRIX_state_t)1 << (btn2 - 1);
+    }
+    
+    return keys;
+}
+
+/*
+ * Builds a complete, delimited frame for record and returns its length (at most BM_FRAME_MAX_SIZE)
+ * Frames must be sent in the order they are encoded, with consecutive sequence numbers.
+ */
+uint8_t BUTTON_MATRIX_encodeFrame(const BUTTON_MATRIX_eventRecord_t *record, uint8_t sequence, uint8_t *frame)
+{
+    uint8_t raw[BM_FRAME_RAW_SIZE];
+    uint8_t flags = 0;
+    uint8_t crc = 0;
+    uint8_t length = 3;
+    uint32_t delta = (record->timestamp - frameTime) >> BM_FRAME_TIME_SHIFT;
+    
+    if(((sequence % BM_FRAME_SYNC_INTERVAL) == 0) || (delta > 0xFFFF) ||
+       (record->keys != bmFrame_impliedKeys(record->btn1, record->btn2)))
+    {
+        flags |= BM_FRAME_FLAG_SYNC;
+        raw[length++] = (uint8_t)record->timestamp;
+        raw[length++] = (uint8_t)(record->timestamp >> 8);
+        raw[length++] = (uint8_t)(record->timestamp >> 16);
+        raw[length++] = (uint8_t)(record->timestamp >> 24);
+        frameTime = record->timestamp;
+    }
+    else
+    {
+        raw[length++] = (uint8_t)delta;
+        raw[length++] = (uint8_t)(delta >> 8);
+        frameTime += delta << BM_FRAME_TIME_SHIFT;
+    }
+    if(record->btn2 != 0)
+    {
+        flags |= BM_FRAME_FLAG_BTN2;
+        raw[length++] = record->btn2;
+    }
+    if(record->duration != 0)
+    {
+        flags |= BM_FRAME_FLAG_DURATION;
+        raw[length++] = (uint8_t)record->duration;
+        raw[length++] = (uint8_t)(record->duration >> 8);
+    }
+    if(record->count != 0)
+    {
+        flags |= BM_FRAME_FLAG_COUNT;
+        raw[length++] = record->count;
+    }
+    if(flags & BM_FRAME_FLAG_SYNC)
+    {
+        for(uint8_t i = 0; i < sizeof(BUTTON_MATRIX_state_t); i++)
+        {
+            raw[length++] = (uint8_t)(record->keys >> (8 * i));
+        }
+    }
+    raw[0] = (record->event & BM_FRAME_EVENT_MASK) | flags;
+    raw[1] = record->btn1;
+    raw[2] = sequence;
+    
+    for(uint8_t i = 0; i < length; i++)
+    {
+        crc = bmFrame_crc8(crc, raw[i]);
+    }
+    raw[length++] = crc;
+    
+    length = bmFrame_cobsEncode(raw, length, frame);
+    frame[length++] = BM_FRAME_DELIMITER;
+    
+    return length;
+}
@@ -0,0 +1,74 @@
+/**
+ * \file button_matrix_frame.h
+ *
+ * \brief Button Matrix binary event framing (COBS + CRC-8).
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_FRAME_H
+#define	BM_FRAME_H
+
+#include <stdint.h>
+#include "button_matrix_queue.h"
+
+/*
+ * Frame layout, before COBS encoding:
+ * | 0             | 1    | 2        | 3..4 or 3..6 | [btn2] | [duration (LE)] | [count] | [keys (LE)] | CRC-8 |
+ * Byte 0 holds the event in its low nibble and the BM_FRAME_FLAG_xxx bits of
+ * the optional fields in its high nibble. Optional fields are only sent when
+ * they are not 0, in the order shown.
+ * A delta frame carries the time since the previous frame, in 1/1024 s
+ * (BM_FRAME_TIME_SHIFT RTC ticks). A sync frame (BM_FRAME_FLAG_SYNC) carries
+ * the full 32-bit RTC time instead and ends with the keys bitmap, sent in
+ * the width of BUTTON_MATRIX_state_t. Sync frames are sent every
+ * BM_FRAME_SYNC_INTERVAL frames, when the delta does not fit 16 bits and
+ * when the keys are not just btn1 and btn2, so delta frames leave the keys
+ * out.
+ * The CRC-8 (polynomial 0x07, initial value 0x00) covers the whole payload.
+ * After COBS encoding the frame contains no zero bytes and is terminated
+ * by a single BM_FRAME_DELIMITER.
+ */
+#define BM_FRAME_DELIMITER      0x00
+#define BM_FRAME_EVENT_MASK     0x0F
+#define BM_FRAME_FLAG_BTN2      0x10
+#define BM_FRAME_FLAG_DURATION  0x20
+#define BM_FRAME_FLAG_COUNT     0x40
+#define BM_FRAME_FLAG_SYNC      0x80
+#define BM_FRAME_TIME_SHIFT     5    /* delta unit: 32 RTC ticks, 0.98 ms */
+#define BM_FRAME_SYNC_INTERVAL  32   /* sequence numbers of sync frames are multiples of this */
+#define BM_FRAME_PAYLOAD_MIN_SIZE   5    /* event, btn1, sequence and time delta only */
+#define BM_FRAME_PAYLOAD_MAX_SIZE   16   /* sync frame with every field and 32-bit keys */
+#define BM_FRAME_RAW_SIZE       (BM_FRAME_PAYLOAD_MAX_SIZE + 1)
+#define BM_FRAME_MAX_SIZE       (BM_FRAME_RAW_SIZE + 2)    /* COBS overhead byte and delimiter */
+
+uint8_t bmFrame_crc8(uint8_t crc, uint8_t data);
+uint8_t bmFrame_cobsEncode(const uint8_t *source, uint8_t length, uint8_t *destination);
+
+uint8_t BUTTON_MATRIX_encodeFrame(const BUTTON_MATRIX_eventRecord_t *record, uint8_t sequence, uint8_t *frame);
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_FRAME_H */
@@ -0,0 +1,298 @@
+/**
+ * \file button_matrix_hal.c
+ *
+ * \brief Button Matrix hardware abstraction on the AVR64DD32 PORT, TCA0 and RTC peripherals.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix_hal.h"
+
+/* Offset needed to enable the pull-up on a specific pin */
+#define BM_PORT_OFFSET          (&(PORTA.PIN0CTRL) - &(PORTA.DIR))
+
+/*
+ * VPORTx mirrors PORTx in the low I/O space, where IN can be read with a single
+ * IN instruction: PORTx sits at 0x0400 + 0x20 * x and VPORTx at 0x0000 + 0x04 * x
+ */
+#define BM_VPORT_OF(port_ptr)   ((VPORT_t *)((uintptr_t)&VPORTA + (((uintptr_t)(port_ptr) - (uintptr_t)&PORTA) >> 3)))
+
+/* Resolved by the compiler: all rows on one port can be sampled with a single read */
+#define BM_ROWS_SHARE_PORT      ((&CFG_ROW0_PORT == &CFG_ROW1_PORT) && \
+                                 (&CFG_ROW0_PORT == &CFG_ROW2_PORT) && \
+                                 (&CFG_ROW0_PORT == &CFG_ROW3_PORT))
+
+/* Rows on consecutive, ascending pins only need a shift to become row levels */
+#define BM_ROWS_CONTIGUOUS      ((CFG_ROW1_PIN == CFG_ROW0_PIN + 1) && \
+                                 (CFG_ROW2_PIN == CFG_ROW0_PIN + 2) && \
+                                 (CFG_ROW3_PIN == CFG_ROW0_PIN + 3))
+
+typedef struct {
+    PORT_t *port;
+    uint8_t position;
+    uint8_t mask;
+} pin_t;
+
+/* Rows that share a port, sampled together with one VPORT read */
+typedef struct {
+    VPORT_t *vport;
+    uint8_t mask;
+} port_group_t;
+
+static const pin_t columns[CFG_COLUMNS] = {
+    {.port = &CFG_COLUMN0_PORT, .position = CFG_COLUMN0_PIN, .mask = (1 << CFG_COLUMN0_PIN)},
+    {.port = &CFG_COLUMN1_PORT, .position = CFG_COLUMN1_PIN, .mask = (1 << CFG_COLUMN1_PIN)},
+    {.port = &CFG_COLUMN2_PORT, .position = CFG_COLUMN2_PIN, .mask = (1 << CFG_COLUMN2_PIN)},
+    {.port = &CFG_COLUMN3_PORT, .position = CFG_COLUMN3_PIN, .mask = (1 << CFG_COLUMN3_PIN)}
+};
+
+static const pin_t rows[CFG_ROWS] = {
+    {.port = &CFG_ROW0_PORT, .position = CFG_ROW0_PIN, .mask = (1 << CFG_ROW0_PIN)},
+    {.port = &CFG_ROW1_PORT, .position = CFG_ROW1_PIN, .mask = (1 << CFG_ROW1_PIN)},
+    {.port = &CFG_ROW2_PORT, .position = CFG_ROW2_PIN, .mask = (1 << CFG_ROW2_PIN)},
+    {.port = &CFG_ROW3_PORT, .position = CFG_ROW3_PIN, .mask = (1 << CFG_ROW3_PIN)}
+};
+
+/* Only used when the rows are spread over several ports, built once by rowGroups_init() */
+static port_group_t rowGroups[CFG_ROWS];
+static uint8_t rowGroupOf[CFG_ROWS];
+static uint8_t rowGroupCount;
+
+/* Groups the rows by port, so a mixed-port layout still reads every port once per column */
+static void rowGroups_init(void)
+{
+    VPORT_t *vport;
+    uint8_t group;
+    
+    rowGroupCount = 0;
+    
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        vport = BM_VPORT_OF(rows[i].port);
+        
+        for(group = 0; group < rowGroupCount; group++)
+        {
+            if(rowGroups[group].vport == vport)
+            {
+                break;
+            }
+        }
+        if(group == rowGroupCount)
+        {
+            rowGroups[group].vport = vport;
+            rowGroups[group].mask = 0;
+            rowGroupCount++;
+        }
+        rowGroups[group].mask |= rows[i].mask;
+        rowGroupOf[i] = group;
+    }
+}
+
+/* Writes the pull-up and the given input sense configuration to all row pins */
+static void setRowSense(uint8_t isc)
+{
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        *((uint8_t *)rows[i].port + BM_PORT_OFFSET + rows[i].position) = PORT_PULLUPEN_bm | isc;
+    }
+}
+
+/* All columns released, rows as inputs with their pull-ups */
+void bmHal_portInit(void)
+{
+    for(uint8_t i = 0; i < CFG_COLUMNS; i++)
+    { 
+        bmHal_releaseColumn(i);
+    }
+    
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        rows[i].port->DIRCLR = rows[i].mask;
+    }
+    setRowSense(PORT_ISC_INTDISABLE_gc);
+    
+    rowGroups_init();
+}
+
+void bmHal_driveColumn(uint8_t column)
+{
+    columns[column].port->DIRSET = columns[column].mask;
+}
+
+void bmHal_releaseColumn(uint8_t column)
+{
+    columns[column].port->DIRCLR = columns[column].mask;
+}
+
+/*
+ * Returns the levels of all rows for the driven column, bit n = row n
+ * Each row port is read exactly once; with the default pin mapping this is a
+ * single VPORTA.IN read followed by a shift.
+ */
+uint8_t bmHal_readRows(void)
+{
+    uint8_t levels = 0;
+    
+    if(BM_ROWS_SHARE_PORT)
+    {
+        uint8_t sample = BM_VPORT_OF(&CFG_ROW0_PORT)->IN;
+        
+#if BM_ROWS_CONTIGUOUS
+        levels = (sample >> CFG_ROW0_PIN) & BM_ROW_LEVELS_MASK;
+#else
+        for(uint8_t i = 0; i < CFG_ROWS; i++)
+        {
+            if(sample & rows[i].mask)
+            {
+                levels |= (1 << i);
+            }
+        }
+#endif
+    }
+    else
+    {
+        uint8_t samples[CFG_ROWS];
+        
+        for(uint8_t group = 0; group < rowGroupCount; group++)
+        {
+            samples[group] = rowGroups[group].vport->IN;
+        }
+        for(uint8_t i = 0; i < CFG_ROWS; i++)
+        {
+            if(samples[rowGroupOf[i]] & rows[i].mask)
+            {
+                levels |= (1 << i);
+            }
+        }
+    }
+    
+    return levels;
+}
+
+/*
+ * Clears the stale flags first, so only an edge from now on wakes the CPU up.
+ * The PORT ISR of the MCC pin manager clears the flags of the edge.
+ */
+void bmHal_enableRowWake(void)
+{
+    for(uint8_t group = 0; group < rowGroupCount; group++)
+    {
+        rowGroups[group].vport->INTFLAGS = rowGroups[group].mask;
+    }
+    setRowSense(PORT_ISC_BOTHEDGES_gc);
+}
+
+void bmHal_disableRowWake(void)
+{
+    setRowSense(PORT_ISC_INTDISABLE_gc);
+}
+
+void bmHal_setScanHandler(bmHal_cb_t handler)
+{
+    TCA0_OverflowCallbackRegister(handler);
+}
+
+void bmHal_stopScan(void)
+{
+    TCA0_Stop();
+}
+
+/* Restarts from a full TCA0 period, which gives the rows time to settle before they are sampled */
+void bmHal_restartScan(void)
+{
+    TCA0_Write(0);
+    TCA0_ClearOverflowInterruptFlag();
+    TCA0_Start();
+}
+
+/* The RTC runs freely over its full 16-bit period; the MCC RTC period must stay at 0xFFFF */
+void bmHal_startTicks(bmHal_cb_t overflow, bmHal_cb_t compare)
+{
+    RTC_DisableCMPInterrupt();
+    RTC_SetOVFIsrCallback(overflow);
+    RTC_SetCMPIsrCallback(compare);
+    RTC_EnableOVFInterrupt();
+    RTC_Start();
+}
+
+uint16_t bmHal_readTicks(void)
+{
+    return RTC.CNT;
+}
+
+/* The counter wrapped but the overflow interrupt has not been served yet */
+bool bmHal_ticksOverflowPending(void)
+{
+    return (RTC.INTFLAGS & RTC_OVF_bm) != 0;
+}
+
+/* The previous compare write is still being synchronized to the RTC clock, for 2 to 3 RTC cycles */
+bool bmHal_tickCompareBusy(void)
+{
+    return (RTC.STATUS & RTC_CMPBUSY_bm) != 0;
+}
+
+/* Arms the compare interrupt; only call it while bmHal_tickCompareBusy is false */
+void bmHal_setTickCompare(uint16_t ticks)
+{
+    RTC.CMP = ticks;
+    RTC.INTFLAGS = RTC_CMP_bm;
+    RTC_EnableCMPInterrupt();
+}
+
+void bmHal_disableTickCompare(void)
+{
+    RTC_DisableCMPInterrupt();
+}
+
+#if CFG_SCAN_LATENCY_PROBE
+/*
+ * TCB0 runs from CLK_PER in frequency measurement mode and is restarted by the
+ * TCA0 overflow event, so its count at handler entry is the number of CPU
+ * cycles between the overflow and the start of the scan.
+ */
+void bmHal_initLatencyProbe(void)
+{
+    EVSYS.CHANNEL0 = EVSYS_CHANNEL0_TCA0_OVF_LUNF_gc;
+    EVSYS.USERTCB0CAPT = EVSYS_USER_CHANNEL0_gc;
+    TCB0.EVCTRL = TCB_CAPTEI_bm;
+    TCB0.CTRLB = TCB_CNTMODE_FRQ_gc;
+    TCB0.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_RUNSTDBY_bm | TCB_ENABLE_bm;
+}
+
+uint16_t bmHal_readLatencyProbe(void)
+{
+    return TCB0.CNT;
+}
+#endif
+
+#if CFG_PROFILER
+/* TCB1 counts CLK_PER cycles in periodic interrupt mode, with the longest period and no interrupt */
+void bmHal_initProfileTimer(void)
+{
+    TCB1.CCMP = UINT16_MAX;
+    TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB1.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_ENABLE_bm;
+}
+
+uint16_t bmHal_readProfileTimer(void)
+{
+    return TCB1.CNT;
+}
+#endif
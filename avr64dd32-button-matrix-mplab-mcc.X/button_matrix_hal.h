@@ -0,0 +1,111 @@
+/**
+ * \file button_matrix_hal.h
+ *
+ * \brief Button Matrix hardware abstraction: matrix pins, scan timer and tick counter.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_HAL_H
+#define	BM_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+
+/*
+ * Everything the button matrix stack needs from the device goes through these
+ * functions. button_matrix_hal.c implements them with the AVR64DD32 PORT,
+ * TCA0 and RTC peripherals; host/bm_hal_host.c implements them with a
+ * simulated matrix and a virtual clock, so the scan, the debounce and the
+ * classifier can run on a PC.
+ */
+
+#ifdef __AVR__
+#include "mcc_generated_files/system/system.h"
+#define BM_HAL_ENTER_CRITICAL()     ENTER_CRITICAL(R)
+#define BM_HAL_EXIT_CRITICAL()      EXIT_CRITICAL(R)
+#else
+/* The simulation only calls the interrupt handlers between two calls into the stack */
+#define BM_HAL_ENTER_CRITICAL()
+#define BM_HAL_EXIT_CRITICAL()
+#endif
+
+/* Constant tables (sequence patterns, keymaps) stay in flash and are read one field at a time */
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define BM_FLASH                            PROGMEM
+#define BM_FLASH_READ(dest, src, size)      memcpy_P((dest), (src), (size))
+#define BM_FLASH_READ_BYTE(src)             pgm_read_byte(src)
+#else
+#include <string.h>
+#define BM_FLASH
+#define BM_FLASH_READ(dest, src, size)      memcpy((dest), (src), (size))
+#define BM_FLASH_READ_BYTE(src)             (*(const uint8_t *)(src))
+#endif
+
+typedef void (*bmHal_cb_t)(void);
+
+/* Row levels of one column, bit n = level of row n */
+#define BM_ROW_LEVELS_MASK      ((uint8_t)((1U << CFG_ROWS) - 1))
+
+/* Matrix pins: columns are driven low one at a time, rows are read through their pull-ups */
+void bmHal_portInit(void);
+void bmHal_driveColumn(uint8_t column);
+void bmHal_releaseColumn(uint8_t column);
+uint8_t bmHal_readRows(void);
+
+/* Row pin change interrupt, used to wake the CPU up while all columns are driven */
+void bmHal_enableRowWake(void);
+void bmHal_disableRowWake(void);
+
+/* Scan timer (TCA0): calls the handler once per BM_SCAN_PERIOD_US */
+void bmHal_setScanHandler(bmHal_cb_t handler);
+void bmHal_stopScan(void);
+void bmHal_restartScan(void);
+
+/* 16-bit tick counter (RTC) at BM_TIMER_TICKS_PER_S, with overflow and compare interrupts */
+void bmHal_startTicks(bmHal_cb_t overflow, bmHal_cb_t compare);
+uint16_t bmHal_readTicks(void);
+bool bmHal_ticksOverflowPending(void);
+bool bmHal_tickCompareBusy(void);
+void bmHal_setTickCompare(uint16_t ticks);
+void bmHal_disableTickCompare(void);
+
+#if CFG_SCAN_LATENCY_PROBE
+/* Cycles between the scan timer overflow and the call to the scan handler */
+void bmHal_initLatencyProbe(void);
+uint16_t bmHal_readLatencyProbe(void);
+#endif
+
+#if CFG_PROFILER
+/* Free-running 16-bit cycle counter for the profiler */
+void bmHal_initProfileTimer(void);
+uint16_t bmHal_readProfileTimer(void);
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_HAL_H */
@@ -0,0 +1,159 @@
+/**
+ * \file button_matrix_keymap.c
+ *
+ * \brief Button Matrix keymap layers between the scan and the event handler.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix.h"
+
+/*
+ * The keymap is a flat [layer][position] table in flash, so a key costs one
+ * table read (two for a transparent key) whatever the size of the table.
+ * The code a key gets when it is pressed is kept until it is released, so
+ * a layer change while the key is held cannot split its press and release.
+ */
+
+#define BM_KEYMAP_POSITIONS         (CFG_ROWS * CFG_COLUMNS)
+
+static const uint8_t *keymapTable;
+static uint8_t keymapLayers;
+static uint8_t momentaryLayers;               /* bit n set while a BM_KEYMAP_MO(n) key is held */
+static uint8_t toggledLayers;                 /* bit n switched by the BM_KEYMAP_TG(n) keys */
+static uint8_t activeLayer;                   /* highest layer that is on, layer 0 is always on */
+static uint8_t pressedCode[BM_KEYMAP_POSITIONS];
+
+/* The highest layer that is on wins */
+static void bmKeymap_updateLayer(void)
+{
+    uint8_t layers = momentaryLayers | toggledLayers;
+    
+    activeLayer = 0;
+    while(layers >>= 1)
+    {
+        activeLayer++;
+    }
+}
+
+static uint8_t bmKeymap_lookup(uint8_t position)
+{
+    uint8_t code;
+    
+    if(keymapTable == NULL)
+    {
+        return position;
+    }
+    
+    code = BM_FLASH_READ_BYTE(&keymapTable[(activeLayer * BM_KEYMAP_POSITIONS) + position - 1]);
+    if(code == BM_KEYMAP_TRANSPARENT)
+    {
+        code = BM_FLASH_READ_BYTE(&keymapTable[position - 1]);
+    }
+    
+    return code;
+}
+
+/*
+ * Sets the keymap: layers x (CFG_ROWS * CFG_COLUMNS) entries in flash (BM_FLASH),
+ * indexed by the physical key number - 1. Call it before BUTTON_MATRIX_init.
+ * Returns false, and keeps the physical key numbers, for 0 or more than 8 layers.
+ */
+bool BUTTON_MATRIX_setKeymap(const uint8_t *keymap, uint8_t layers)
+{
+    if((layers == 0) || (layers > BM_KEYMAP_MAX_LAYERS))
+    {
+        keymapTable = NULL;
+        return false;
+    }
+    
+    keymapTable = keymap;
+    keymapLayers = layers;
+    
+    return true;
+}
+
+/* Layer the keys are currently looked up in */
+uint8_t BUTTON_MATRIX_getLayer(void)
+{
+    return activeLayer;
+}
+
+void bmKeymap_init(void)
+{
+    momentaryLayers = 0;
+    toggledLayers = 0;
+    activeLayer = 0;
+    for(uint8_t i = 0; i < BM_KEYMAP_POSITIONS; i++)
+    {
+        pressedCode[i] = BM_KEYMAP_NONE;
+    }
+}
+
+/* Maps a debounced edge of the physical key position (1 based) and passes it on */
+void bmKeymap_event(uint8_t position, bool state)
+{
+    uint8_t code;
+    uint8_t layer;
+    
+    if(state == BM_BUTTON_PRESSED)
+    {
+        code = bmKeymap_lookup(position);
+        pressedCode[position - 1] = code;
+    }
+    else
+    {
+        code = pressedCode[position - 1];
+        pressedCode[position - 1] = BM_KEYMAP_NONE;
+    }
+    
+    if((code == BM_KEYMAP_NONE) || (code == BM_KEYMAP_TRANSPARENT))
+    {
+        return;
+    }
+    
+    layer = code & 0x3F;
+    if((code & 0xC0) == 0x40)
+    {
+        if(layer < keymapLayers)
+        {
+            if(state == BM_BUTTON_PRESSED)
+            {
+                momentaryLayers |= (1 << layer);
+            }
+            else
+            {
+                momentaryLayers &= ~(1 << layer);
+            }
+            bmKeymap_updateLayer();
+        }
+    }
+    else if((code & 0xC0) == 0x80)
+    {
+        if((layer < keymapLayers) && (state == BM_BUTTON_PRESSED))
+        {
+            toggledLayers ^= (1 << layer);
+            bmKeymap_updateLayer();
+        }
+    }
+    else if(code <= BM_KEY_CODES)
+    {
+        BUTTON_MATRIX_EventHandler(code, state);
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * \file button_matrix_keymap.h
+ *
+ * \brief Button Matrix keymap layers header file.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_KEYMAP_H
+#define	BM_KEYMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+#include "button_matrix_hal.h"
+
+/*
+ * Keymap entries, one byte per physical key and layer:
+ * 1 to CFG_KEYMAP_CODES are the key codes passed to the event handler,
+ * the other values act on the layers and are never reported.
+ */
+#define BM_KEYMAP_NONE              0x00                /* the key does nothing on this layer */
+#define BM_KEYMAP_MO(layer)         (0x40 | (layer))    /* layer is active while the key is held */
+#define BM_KEYMAP_TG(layer)         (0x80 | (layer))    /* each press switches layer on or off */
+#define BM_KEYMAP_TRANSPARENT       0xFF                /* the key does what it does on layer 0 */
+
+#define BM_KEYMAP_MAX_LAYERS        8
+
+bool BUTTON_MATRIX_setKeymap(const uint8_t *keymap, uint8_t layers);
+uint8_t BUTTON_MATRIX_getLayer(void);
+void bmKeymap_init(void);
+void bmKeymap_event(uint8_t position, bool state);
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_KEYMAP_H */
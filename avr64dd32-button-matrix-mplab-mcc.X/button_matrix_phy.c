@@ -24,92 +24,486 @@
 
 #include "button_matrix_phy.h"
 
-static const pin_t columns[CFG_COLUMNS] = {
-    {.port = &CFG_COLUMN0_PORT, .position = CFG_COLUMN0_PIN},
-    {.port = &CFG_COLUMN1_PORT, .position = CFG_COLUMN1_PIN},
-    {.port = &CFG_COLUMN2_PORT, .position = CFG_COLUMN2_PIN},
-    {.port = &CFG_COLUMN3_PORT, .position = CFG_COLUMN3_PIN}
-};
-
-static const pin_t rows[CFG_ROWS] = {
-    {.port = &CFG_ROW0_PORT, .position = CFG_ROW0_PIN},
-    {.port = &CFG_ROW1_PORT, .position = CFG_ROW1_PIN},
-    {.port = &CFG_ROW2_PORT, .position = CFG_ROW2_PIN},
-    {.port = &CFG_ROW3_PORT, .position = CFG_ROW3_PIN}
-};
+/* Debounced keys, written by the scan ISR under the stableSeq sequence counter */
+static volatile BUTTON_MATRIX_state_t stableState;
+static volatile uint8_t stableSeq;
 
+/* Column driven since the previous scan */
+static uint8_t column_index;
+
+#if CFG_IDLE_WAKEUP
+static volatile bool idle;
+static uint8_t quietScans;
+static volatile uint16_t idleEntries;
+static volatile uint16_t idleWakeups;
+static uint32_t wakeTime;                             /* row pin change that ended the idle mode */
+static uint8_t wakeScans;                             /* scans left until every column has been read since then */
+#endif
+
+#if CFG_DEBOUNCE_ALGORITHM == BM_DEBOUNCE_VERTICAL
+static bm_vertical_t columnDebounce[CFG_COLUMNS];
+#else
 static button_t buttonMatrix[CFG_ROWS][CFG_COLUMNS];
+#endif
+
+static uint32_t rawEdgeTime[CFG_ROWS * CFG_COLUMNS];  /* when each key left its debounced level */
+static uint8_t rawAway[CFG_COLUMNS];                  /* rows of each column read away from their debounced level */
+static bool rawEdgeValid;
+static uint32_t rawEdgeReported;                      /* stamp of the key being passed to the event handler */
 
-static void setOutput(int index)
+/*
+ * Stamps the keys whose level starts to differ from their debounced state
+ * A key read away for the first time since the row pin change woke the scan
+ * up is stamped with the pin change, otherwise with the middle of the column
+ * cycle before this read. Bounces back to the debounced level keep the first
+ * stamp until the debounced state changes, or until the stamp is older than
+ * BM_RAW_EDGE_HOLD_TICKS, so a glitch that never passed the debounce is
+ * forgotten.
+ */
+static void rawEdge_sample(uint8_t column, uint8_t row_levels)
 {
-    columns[index].port->DIRSET = 0x01 << columns[index].position;
+    uint8_t away = 0;
+    uint8_t started;
+    uint8_t back;
+    uint32_t read_time;
+    uint32_t now;
+    
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        bool raw_pressed = (((row_levels >> i) & 0x01) == BM_BUTTON_PRESSED);
+        bool stable_pressed = ((stableState >> (column + (i * CFG_COLUMNS))) & 0x01) != 0;
+        
+        if(raw_pressed != stable_pressed)
+        {
+            away |= (uint8_t)(1 << i);
+        }
+    }
+    
+    started = away & (uint8_t)~rawAway[column];
+    back = rawAway[column] & (uint8_t)~away;
+    if((started | back) == 0)
+    {
+        return;
+    }
+    
+    read_time = bmTimer_now();
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        if((back & (1 << i)) && ((read_time - rawEdgeTime[column + (i * CFG_COLUMNS)]) > BM_RAW_EDGE_HOLD_TICKS))
+        {
+            rawAway[column] &= (uint8_t)~(1 << i);
+        }
+    }
+    rawAway[column] |= started;
+    
+    now = read_time - BM_RAW_EDGE_OFFSET_TICKS;
+#if CFG_IDLE_WAKEUP
+    if(wakeScans != 0)
+    {
+        now = wakeTime;
+    }
+#endif
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        if(started & (1 << i))
+        {
+            rawEdgeTime[column + (i * CFG_COLUMNS)] = now;
+        }
+    }
 }
 
-static void setInput(int index)
+/* While the scan reports an edge: when the key left its previous level */
+bool buttonMatrixPhy_getRawEdge(uint32_t *time)
 {
-    columns[index].port->DIRCLR = 0x01 << columns[index].position;
+    *time = rawEdgeReported;
+    
+    return rawEdgeValid;
 }
 
-static bool readInput(int index)
+#if CFG_SCAN_LATENCY_PROBE
+static volatile uint16_t scanLatencyMin;
+static volatile uint16_t scanLatencyMax;
+static volatile bool scanLatencyReset;
+
+static void scanLatencyProbe_init(void)
 {
-    return (rows[index].port->IN & (0x01 << rows[index].position));
+    scanLatencyMin = UINT16_MAX;
+    scanLatencyMax = 0;
+    scanLatencyReset = false;
+    
+    bmHal_initLatencyProbe();
 }
 
-static void PORT_init(void)
+static void scanLatencyProbe_sample(void)
 {
-    setOutput(0);
+    uint16_t latency = bmHal_readLatencyProbe();
     
-    for(int i = 1; i < CFG_COLUMNS; i++)
-    { 
-        columns[i].port->DIRCLR = (0x01 << columns[i].position);
+    if(scanLatencyReset)
+    {
+        scanLatencyReset = false;
+        scanLatencyMin = UINT16_MAX;
+        scanLatencyMax = 0;
     }
-    
-    for(int i = 0; i < CFG_ROWS; i++)
+    if(latency < scanLatencyMin)
+    {
+        scanLatencyMin = latency;
+    }
+    if(latency > scanLatencyMax)
+    {
+        scanLatencyMax = latency;
+    }
+}
+
+/* The values are 16 bits wide, so read them until two reads agree instead of masking interrupts */
+void buttonMatrixPhy_getScanLatency(uint16_t *min, uint16_t *max)
+{
+    do
+    {
+        *min = scanLatencyMin;
+        *max = scanLatencyMax;
+    } while((*min != scanLatencyMin) || (*max != scanLatencyMax));
+}
+
+/* The reset is carried out by the next scan, so the ISR stays the only writer of the 16-bit values */
+void buttonMatrixPhy_resetScanLatency(void)
+{
+    scanLatencyReset = true;
+}
+#endif
+
+static void PORT_init(void)
+{
+    bmHal_portInit();
+    bmHal_driveColumn(0);
+}
+
+#if CFG_DEBOUNCE_ALGORITHM == BM_DEBOUNCE_VERTICAL
+static void debounce_init(void)
+{
+    for(uint8_t j = 0; j < CFG_COLUMNS; j++)
     {
-        rows[i].port->DIRCLR = (0x01 << rows[i].position);
-        *((uint8_t *)rows[i].port + BM_PORT_OFFSET + rows[i].position) = PORT_PULLUPEN_bm;
+        columnDebounce[j].state = BM_ROW_LEVELS_MASK;
+        columnDebounce[j].count0 = 0;
+        columnDebounce[j].count1 = 0;
+        columnDebounce[j].count2 = 0;
+#if CFG_DEBOUNCE_LOCKOUT
+        columnDebounce[j].lock0 = 0;
+        columnDebounce[j].lock1 = 0;
+        columnDebounce[j].lock2 = 0;
+#endif
     }
 }
 
+/* Rows whose three-plane counter equals the constant n */
+#define BM_VERTICAL_COUNT_IS(n, c0, c1, c2) \
+    ((((n) & 0x01) ? (c0) : (uint8_t)~(c0)) & (((n) & 0x02) ? (c1) : (uint8_t)~(c1)) & (((n) & 0x04) ? (c2) : (uint8_t)~(c2)))
+
 /*
- * Button Matrix Interrupt Handler
- * This function is called every 5 ms, when the TCA OVF Interrupt is triggered
- * Scans one column of the button matrix each 5 ms and identifies an event
+ * Debounces all rows of one column at once
+ * Bit n of the three count planes holds the counter of row n. Rows whose level
+ * differs from the stable state count up, all others are cleared, so each row
+ * behaves like the per-button counter of the counter engine. Released rows
+ * count towards the press time, pressed rows towards the release time.
  */
-static void buttonMatrixPhy_handler(void)
+static uint8_t debounceColumn(uint8_t column, uint8_t row_levels)
 {
-    static int column_index = 0;
-    bool input_state = BM_BUTTON_RELEASED;
+    bm_vertical_t *debounce = &columnDebounce[column];
+    uint8_t delta = row_levels ^ debounce->state;
+    uint8_t count0 = debounce->count0;
+    uint8_t count1 = debounce->count1;
+    uint8_t count2 = debounce->count2;
+    uint8_t expired;
+#if CFG_DEBOUNCE_LOCKOUT
+    uint8_t locked = debounce->lock0 | debounce->lock1 | debounce->lock2;
+    uint8_t borrow0 = locked & ~debounce->lock0;
+    uint8_t borrow1 = borrow0 & ~debounce->lock1;
+    uint8_t pressed;
     
-    if(column_index == 0)
-    {
-        setInput(CFG_COLUMNS - 1);
-    }
-    else if (column_index > 0)
+    /* Count the lockouts down; a locked row keeps its counter cleared */
+    debounce->lock0 ^= locked;
+    debounce->lock1 ^= borrow0;
+    debounce->lock2 ^= borrow1;
+    delta &= ~locked;
+#endif
+    
+    count2 = (count2 ^ (count1 & count0)) & delta;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+    
+    /* Rows whose counter has just reached the threshold of their direction */
+    expired = delta & ((debounce->state & BM_VERTICAL_COUNT_IS(CFG_DEBOUNCE_PRESS_TIME, count0, count1, count2)) |
+                       (~debounce->state & BM_VERTICAL_COUNT_IS(CFG_DEBOUNCE_RELEASE_TIME, count0, count1, count2)));
+    
+    debounce->count0 = count0 & ~expired;
+    debounce->count1 = count1 & ~expired;
+    debounce->count2 = count2 & ~expired;
+    
+#if CFG_DEBOUNCE_LOCKOUT
+    /* Rows that have just been pressed ignore their level for the next CFG_DEBOUNCE_LOCKOUT scans */
+    pressed = expired & debounce->state;
+    debounce->lock0 = (debounce->lock0 & ~pressed) | ((CFG_DEBOUNCE_LOCKOUT & 0x01) ? pressed : 0);
+    debounce->lock1 = (debounce->lock1 & ~pressed) | ((CFG_DEBOUNCE_LOCKOUT & 0x02) ? pressed : 0);
+    debounce->lock2 = (debounce->lock2 & ~pressed) | ((CFG_DEBOUNCE_LOCKOUT & 0x04) ? pressed : 0);
+#endif
+    
+    debounce->state ^= expired;
+    
+    return expired;
+}
+#else
+static void debounce_init(void)
+{
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
     {
-        setInput(column_index - 1);
+        for(uint8_t j = 0; j < CFG_COLUMNS; j++)
+        {
+            buttonMatrix[i][j].debounce_count = 0;
+#if CFG_DEBOUNCE_LOCKOUT
+            buttonMatrix[i][j].lockout = 0;
+#endif
+            buttonMatrix[i][j].state = BM_BUTTON_RELEASED;
+        }
     }
+}
+
+/*
+ * Debounces the rows of one column one button at a time
+ * A press has to be stable for CFG_DEBOUNCE_PRESS_TIME scans, a release for
+ * CFG_DEBOUNCE_RELEASE_TIME scans. After a press, the button ignores its row
+ * for CFG_DEBOUNCE_LOCKOUT scans, so contact bounce cannot count as a release.
+ */
+static uint8_t debounceColumn(uint8_t column, uint8_t row_levels)
+{
+    uint8_t expired = 0;
+    bool input_state;
     
-    for(int i = 0; i < CFG_ROWS; i++)
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
     {
-        input_state = readInput(i);
+#if CFG_DEBOUNCE_LOCKOUT
+        if(buttonMatrix[i][column].lockout)
+        {
+            buttonMatrix[i][column].lockout--;
+            continue;
+        }
+#endif
+        input_state = (row_levels >> i) & 0x01;
         
-        if(input_state == buttonMatrix[i][column_index].state)
+        if(input_state == buttonMatrix[i][column].state)
         {
-            buttonMatrix[i][column_index].debounce_count = 0;
+            buttonMatrix[i][column].debounce_count = 0;
         }
         else
         {
-            buttonMatrix[i][column_index].debounce_count++;
-            if(buttonMatrix[i][column_index].debounce_count == CFG_DEBOUNCE_TIME)
+            buttonMatrix[i][column].debounce_count++;
+            if(buttonMatrix[i][column].debounce_count == ((input_state == BM_BUTTON_PRESSED) ? CFG_DEBOUNCE_PRESS_TIME : CFG_DEBOUNCE_RELEASE_TIME))
+            {
+                buttonMatrix[i][column].state = input_state;
+                buttonMatrix[i][column].debounce_count = 0;
+#if CFG_DEBOUNCE_LOCKOUT
+                if(input_state == BM_BUTTON_PRESSED)
+                {
+                    buttonMatrix[i][column].lockout = CFG_DEBOUNCE_LOCKOUT;
+                }
+#endif
+                expired |= (1 << i);
+            }
+        }
+    }
+    
+    return expired;
+}
+#endif
+
+/*
+ * Publishes the rows of one column that changed state, then reports them
+ * The bitmap is updated first, so an event handler already sees the new state.
+ */
+static void reportChanges(uint8_t column, uint8_t changed, uint8_t row_levels)
+{
+    BUTTON_MATRIX_state_t state = stableState;
+    BUTTON_MATRIX_state_t key_bit;
+    
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        if(changed & (1 << i))
+        {
+            key_bit = (BUTTON_MATRIX_state_t)1 << (column + (i * CFG_COLUMNS));
+            if(((row_levels >> i) & 0x01) == BM_BUTTON_PRESSED)
+            {
+                state |= key_bit;
+            }
+            else
             {
-                buttonMatrix[i][column_index].state = input_state;
-                buttonMatrix[i][column_index].debounce_count = 0;
-                BUTTON_MATRIX_EventHandler((column_index + (i * CFG_COLUMNS)) + 1, input_state);
+                state &= ~key_bit;
             }
         }
     }
     
+    stableSeq++;
+    BM_RING_BARRIER();
+    stableState = state;
+    BM_RING_BARRIER();
+    stableSeq++;
+    
+    for(uint8_t i = 0; i < CFG_ROWS; i++)
+    {
+        if(changed & (1 << i))
+        {
+            rawEdgeReported = rawEdgeTime[column + (i * CFG_COLUMNS)];
+            rawEdgeValid = true;
+#if CFG_KEYMAP
+            bmKeymap_event((column + (i * CFG_COLUMNS)) + 1, (row_levels >> i) & 0x01);
+#else
+            BUTTON_MATRIX_EventHandler((column + (i * CFG_COLUMNS)) + 1, (row_levels >> i) & 0x01);
+#endif
+        }
+    }
+    rawEdgeValid = false;
+}
+
+/*
+ * Seqlock read: the sequence counter is odd while the ISR updates the bitmap,
+ * so retry until it is even and unchanged around the copy
+ */
+BUTTON_MATRIX_state_t buttonMatrixPhy_getState(void)
+{
+    BUTTON_MATRIX_state_t state;
+    uint8_t seq;
+    
+    do
+    {
+        seq = stableSeq;
+        BM_RING_BARRIER();
+        state = stableState;
+        BM_RING_BARRIER();
+    } while((seq & 0x01) || (seq != stableSeq));
+    
+    return state;
+}
+
+#if CFG_IDLE_WAKEUP
+/*
+ * Stops sensing the rows, drives only the next column again and restarts the
+ * scan from a full TCA0 period, which gives the rows time to settle before
+ * they are sampled
+ */
+static void idle_exit(void)
+{
+    if(!idle)
+    {
+        return;
+    }
+    
+    bmHal_disableRowWake();
+    for(uint8_t i = 0; i < CFG_COLUMNS; i++)
+    {
+        if(i != column_index)
+        {
+            bmHal_releaseColumn(i);
+        }
+    }
+    
+    wakeTime = bmTimer_now();
+    wakeScans = CFG_COLUMNS;
+    quietScans = 0;
+    idle = false;
+    idleWakeups++;
+    
+    bmHal_restartScan();
+}
+
+/*
+ * Called by the scan once a full pass saw no pressed or bouncing key: drives
+ * all columns low and lets any row edge wake the scan up again
+ */
+static void idle_enter(void)
+{
+    bmHal_stopScan();
+    
+    for(uint8_t i = 0; i < CFG_COLUMNS; i++)
+    {
+        bmHal_driveColumn(i);
+    }
+    bmHal_enableRowWake();
+    
+    idle = true;
+    idleEntries++;
+    
+    /* A key pressed while the sensing was being armed did not produce an edge */
+    if(bmHal_readRows() != BM_ROW_LEVELS_MASK)
+    {
+        idle_exit();
+    }
+}
+
+/*
+ * The row pin change interrupt only wakes the CPU up; the pin manager ISR
+ * clears its flags. A row read away from its released level means a key went
+ * down since the scan stopped.
+ */
+bool buttonMatrixPhy_wakePending(void)
+{
+    return idle && (bmHal_readRows() != BM_ROW_LEVELS_MASK);
+}
+
+/* Called from the main loop through BUTTON_MATRIX_Tasks */
+void buttonMatrixPhy_tasks(void)
+{
+    if(buttonMatrixPhy_wakePending())
+    {
+        idle_exit();
+    }
+}
+
+bool buttonMatrixPhy_isIdle(void)
+{
+    return idle;
+}
+
+/* The counters are 16 bits wide, so read them until two reads agree instead of masking interrupts */
+void buttonMatrixPhy_getIdleStats(uint16_t *entries, uint16_t *wakeups)
+{
+    do
+    {
+        *entries = idleEntries;
+        *wakeups = idleWakeups;
+    } while((*entries != idleEntries) || (*wakeups != idleWakeups));
+}
+#endif
+
+/*
+ * Button Matrix Interrupt Handler
+ * This function is called every 5 ms, when the TCA OVF Interrupt is triggered
+ * Scans one column of the button matrix each 5 ms and identifies an event
+ */
+static void buttonMatrixPhy_handler(void)
+{
+    BM_PROFILE_BEGIN();
+    uint8_t row_levels;
+    uint8_t changed;
+    
+#if CFG_SCAN_LATENCY_PROBE
+    scanLatencyProbe_sample();
+#endif
+    
+    /* Only the current column has been driven since the previous scan */
+    row_levels = bmHal_readRows();
+    rawEdge_sample(column_index, row_levels);
+#if CFG_IDLE_WAKEUP
+    if(wakeScans != 0)
+    {
+        wakeScans--;
+    }
+#endif
+    changed = debounceColumn(column_index, row_levels);
+    if(changed)
+    {
+        /* These rows now read their debounced level, so the next read away from it is a new edge, even after idle */
+        rawAway[column_index] &= (uint8_t)~changed;
+        reportChanges(column_index, changed, row_levels);
+    }
+    
+    bmHal_releaseColumn(column_index);
     column_index++;
     
     if(column_index >= CFG_COLUMNS)
@@ -117,20 +511,48 @@ static void buttonMatrixPhy_handler(void)
         column_index = 0;
     }
     
-    setOutput(column_index);
+    bmHal_driveColumn(column_index);
+    
+#if CFG_IDLE_WAKEUP
+    /* Every column read back released, so all debounce counters are idle too */
+    if((row_levels == BM_ROW_LEVELS_MASK) && (stableState == 0))
+    {
+        quietScans++;
+        if(quietScans >= CFG_COLUMNS)
+        {
+            idle_enter();
+        }
+    }
+    else
+    {
+        quietScans = 0;
+    }
+#endif
+    
+    BM_PROFILE_END(BM_PROFILE_SCAN);
 }
 
 void buttonMatrixPhy_init(void)
 {
     PORT_init();
-    TCA0_OverflowCallbackRegister(buttonMatrixPhy_handler);
-    
-    for(int i = 0; i < CFG_ROWS; i++)
+#if CFG_SCAN_LATENCY_PROBE
+    scanLatencyProbe_init();
+#endif
+    bmHal_setScanHandler(buttonMatrixPhy_handler);
+    debounce_init();
+    for(uint8_t j = 0; j < CFG_COLUMNS; j++)
     {
-        for(int j = 0; j < CFG_COLUMNS; j++)
-        {
-            buttonMatrix[i][j].debounce_count = 0;
-            buttonMatrix[i][j].state = BM_BUTTON_RELEASED;
-        }
+        rawAway[j] = 0;
     }
+    rawEdgeValid = false;
+    stableState = 0;
+    stableSeq = 0;
+    column_index = 0;
+#if CFG_IDLE_WAKEUP
+    idle = false;
+    quietScans = 0;
+    idleEntries = 0;
+    idleWakeups = 0;
+    wakeScans = 0;
+#endif
 }
\ No newline at end of file
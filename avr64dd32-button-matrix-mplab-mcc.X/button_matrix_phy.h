@@ -25,30 +25,91 @@
 #ifndef BUTTON_MATRIX
 #define	BUTTON_MATRIX
 
-#include "mcc_generated_files/system/system.h"
 #include "button_matrix_config.h"
+#include "button_matrix_hal.h"
+#include "button_matrix_queue.h"
 #include "button_matrix.h"
-#include <util/delay.h>
 
-/* Offset needed to enable the pull-up on a specific pin */
-#define BM_PORT_OFFSET          (&(PORTA.PIN0CTRL) - &(PORTA.DIR))
 /* Default value used to indicate that none of the buttons have been pressed */
 #define BM_NULL_BTN             0
     
 #define BM_BUTTON_PRESSED       0
 #define BM_BUTTON_RELEASED      1
 
-typedef struct {
-    PORT_t *port;
-    uint8_t position;
-} pin_t;
+/* TCA0 overflow period as set in MCC: (PER + 1) * 64 / 4 MHz */
+#define BM_SCAN_PERIOD_US       5008UL
+
+/*
+ * RTC ticks from the middle of the column cycle before the first read of a key
+ * at its new level to that read: the edge happened during that cycle, so the
+ * reported time is off by half a cycle, 10 ms at the most with 4 columns
+ */
+#define BM_RAW_EDGE_OFFSET_TICKS    ((uint32_t)(((uint32_t)CFG_COLUMNS * BM_SCAN_PERIOD_US * 32768UL) / 2000000UL))
+
+/* RTC ticks a raw edge stamp survives reads back at the debounced level: the longer debounce time and the lockout */
+#define BM_RAW_EDGE_HOLD_SCANS      (((CFG_DEBOUNCE_PRESS_TIME > CFG_DEBOUNCE_RELEASE_TIME) ? CFG_DEBOUNCE_PRESS_TIME : CFG_DEBOUNCE_RELEASE_TIME) + CFG_DEBOUNCE_LOCKOUT)
+#define BM_RAW_EDGE_HOLD_TICKS      ((uint32_t)(((uint32_t)BM_RAW_EDGE_HOLD_SCANS * CFG_COLUMNS * BM_SCAN_PERIOD_US * 32768UL) / 1000000UL))
+
+/* Values for CFG_DEBOUNCE_ALGORITHM */
+#define BM_DEBOUNCE_COUNTER     0    /* one counter byte and one state byte per button */
+#define BM_DEBOUNCE_VERTICAL    1    /* three count bit-planes and one state byte per column */
+
+#if (CFG_DEBOUNCE_PRESS_TIME < 1) || (CFG_DEBOUNCE_RELEASE_TIME < 1)
+#error "CFG_DEBOUNCE_PRESS_TIME and CFG_DEBOUNCE_RELEASE_TIME must be at least 1 scan"
+#endif
+
+#if (CFG_DEBOUNCE_ALGORITHM == BM_DEBOUNCE_VERTICAL) && ((CFG_DEBOUNCE_PRESS_TIME > 7) || (CFG_DEBOUNCE_RELEASE_TIME > 7) || (CFG_DEBOUNCE_LOCKOUT > 7))
+#error "The vertical counter debounce supports debounce times and a lockout of up to 7 scans"
+#endif
+
+#if (CFG_DEBOUNCE_ALGORITHM == BM_DEBOUNCE_COUNTER) && ((CFG_DEBOUNCE_PRESS_TIME > 255) || (CFG_DEBOUNCE_RELEASE_TIME > 255) || (CFG_DEBOUNCE_LOCKOUT > 255))
+#error "The counter debounce supports debounce times and a lockout of up to 255 scans"
+#endif
+
+#if CFG_ROWS > 8
+#error "CFG_ROWS must not exceed 8, the row levels of one column are sampled into a byte"
+#endif
+
+/* True when the physical button key (1 based) is pressed in a state returned by BUTTON_MATRIX_getState(), not a keymap code */
+#define BUTTON_MATRIX_IS_PRESSED(state, key)    (((state) >> ((key) - 1)) & 0x01)
 
 typedef struct {
     uint8_t debounce_count;
+#if CFG_DEBOUNCE_LOCKOUT
+    uint8_t lockout;    /* scans left during which the row is ignored */
+#endif
     bool state;
 } button_t;
 
+/* Vertical counters of one column, bit n belongs to row n */
+typedef struct {
+    uint8_t state;      /* debounced levels */
+    uint8_t count0;     /* counter bit 0 */
+    uint8_t count1;     /* counter bit 1 */
+    uint8_t count2;     /* counter bit 2 */
+#if CFG_DEBOUNCE_LOCKOUT
+    uint8_t lock0;      /* lockout down-counter bit 0 */
+    uint8_t lock1;      /* lockout down-counter bit 1 */
+    uint8_t lock2;      /* lockout down-counter bit 2 */
+#endif
+} bm_vertical_t;
+
 void buttonMatrixPhy_init(void);
+BUTTON_MATRIX_state_t buttonMatrixPhy_getState(void);
+
+#if CFG_IDLE_WAKEUP
+bool buttonMatrixPhy_isIdle(void);
+bool buttonMatrixPhy_wakePending(void);
+void buttonMatrixPhy_tasks(void);
+void buttonMatrixPhy_getIdleStats(uint16_t *entries, uint16_t *wakeups);
+#endif
+
+bool buttonMatrixPhy_getRawEdge(uint32_t *time);
+
+#if CFG_SCAN_LATENCY_PROBE
+void buttonMatrixPhy_getScanLatency(uint16_t *min, uint16_t *max);
+void buttonMatrixPhy_resetScanLatency(void);
+#endif
 
 #ifdef	__cplusplus
 extern "C" {
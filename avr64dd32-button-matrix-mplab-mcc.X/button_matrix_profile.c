@@ -0,0 +1,96 @@
+/**
+ * \file button_matrix_profile.c
+ *
+ * \brief Button Matrix interrupt and callback cycle profiler.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix_profile.h"
+
+#if CFG_PROFILER
+/*
+ * Each site reads the free-running profile timer when it starts and records
+ * the difference when it ends. The timer is 16 bits wide, so a single run
+ * may last up to 65535 cycles. The two timer reads are part of the result.
+ */
+
+static BUTTON_MATRIX_profile_t profile[BM_PROFILE_SITES];
+
+static void bmProfile_clear(void)
+{
+    for(uint8_t site = 0; site < BM_PROFILE_SITES; site++)
+    {
+        profile[site].count = 0;
+        profile[site].min = UINT16_MAX;
+        profile[site].max = 0;
+        profile[site].sum = 0;
+    }
+}
+
+void bmProfile_init(void)
+{
+    bmProfile_clear();
+    bmHal_initProfileTimer();
+}
+
+/* A site only ever runs in one context at a time, so its entry needs no protection here */
+void bmProfile_record(bmProfile_site_t site, uint16_t start)
+{
+    BUTTON_MATRIX_profile_t *entry = &profile[site];
+    uint16_t cycles = bmHal_readProfileTimer() - start;
+    
+    if(cycles < entry->min)
+    {
+        entry->min = cycles;
+    }
+    if(cycles > entry->max)
+    {
+        entry->max = cycles;
+    }
+    if(entry->count < UINT16_MAX)
+    {
+        entry->count++;
+        entry->sum += cycles;
+    }
+}
+
+/* Copies the profile of one site; false for an unknown site */
+bool BUTTON_MATRIX_getProfile(uint8_t site, BUTTON_MATRIX_profile_t *result)
+{
+    if(site >= BM_PROFILE_SITES)
+    {
+        return false;
+    }
+    
+    BM_HAL_ENTER_CRITICAL();
+    *result = profile[site];
+    BM_HAL_EXIT_CRITICAL();
+    
+    return true;
+}
+
+/* Starts a new measurement window for every site */
+void BUTTON_MATRIX_resetProfile(void)
+{
+    BM_HAL_ENTER_CRITICAL();
+    bmProfile_clear();
+    BM_HAL_EXIT_CRITICAL();
+}
+#endif
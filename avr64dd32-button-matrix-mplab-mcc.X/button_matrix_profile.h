@@ -0,0 +1,72 @@
+/**
+ * \file button_matrix_profile.h
+ *
+ * \brief Button Matrix interrupt and callback cycle profiler.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_PROFILE_H
+#define	BM_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+#include "button_matrix_hal.h"
+
+/* Code paths timed by the profiler */
+typedef enum {
+    BM_PROFILE_SCAN,        /* scan handler, called from the TCA0 overflow interrupt */
+    BM_PROFILE_RTC,         /* tick overflow and compare handlers, called from the RTC interrupt */
+    BM_PROFILE_CALLBACK,    /* user callbacks and subscribers of one event */
+    BM_PROFILE_RTC_SYNC,    /* waits for the previous RTC compare write to synchronize */
+    BM_PROFILE_SITES
+} bmProfile_site_t;
+
+/* Durations in cycles of the profile timer; the count stops at UINT16_MAX, so sum / count stays exact */
+typedef struct {
+    uint16_t count;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+} BUTTON_MATRIX_profile_t;
+
+#if CFG_PROFILER
+#define BM_PROFILE_BEGIN()          uint16_t bmProfileStart = bmHal_readProfileTimer()
+#define BM_PROFILE_END(site)        bmProfile_record((site), bmProfileStart)
+
+void bmProfile_init(void);
+void bmProfile_record(bmProfile_site_t site, uint16_t start);
+
+bool BUTTON_MATRIX_getProfile(uint8_t site, BUTTON_MATRIX_profile_t *profile);
+void BUTTON_MATRIX_resetProfile(void);
+#else
+#define BM_PROFILE_BEGIN()
+#define BM_PROFILE_END(site)
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_PROFILE_H */
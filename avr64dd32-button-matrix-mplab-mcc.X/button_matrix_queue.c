@@ -0,0 +1,172 @@
+/**
+ * \file button_matrix_queue.c
+ *
+ * \brief Button Matrix single-producer/single-consumer event queue.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix_queue.h"
+
+static bm_ring_t eventRing;
+static BUTTON_MATRIX_eventRecord_t eventBuffer[CFG_EVENT_QUEUE_SIZE];
+
+/* Function that empties the ring and clears its statistics */
+void bmRing_init(bm_ring_t *ring, uint8_t size)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = size - 1;
+    ring->high_water = 0;
+    ring->drops = 0;
+}
+
+/* Producer side: returns the slot to fill, or BM_RING_NO_SLOT (and counts a drop) when full */
+uint8_t bmRing_writeSlot(bm_ring_t *ring)
+{
+    uint8_t head = ring->head;
+
+    if((uint8_t)(head - ring->tail) > ring->mask)
+    {
+        if(ring->drops != UINT16_MAX)
+        {
+            ring->drops++;
+        }
+        return BM_RING_NO_SLOT;
+    }
+
+    return head & ring->mask;
+}
+
+/* Producer side: makes the slot returned by bmRing_writeSlot visible to the consumer */
+void bmRing_publish(bm_ring_t *ring)
+{
+    uint8_t used;
+
+    BM_RING_BARRIER();
+    ring->head++;
+
+    used = ring->head - ring->tail;
+    if(used > ring->high_water)
+    {
+        ring->high_water = used;
+    }
+}
+
+/* Consumer side: returns the oldest filled slot, or BM_RING_NO_SLOT when empty */
+uint8_t bmRing_readSlot(bm_ring_t *ring)
+{
+    uint8_t tail = ring->tail;
+
+    if(tail == ring->head)
+    {
+        return BM_RING_NO_SLOT;
+    }
+
+    BM_RING_BARRIER();
+    return tail & ring->mask;
+}
+
+/* Consumer side: hands the slot returned by bmRing_readSlot back to the producer */
+void bmRing_release(bm_ring_t *ring)
+{
+    BM_RING_BARRIER();
+    ring->tail++;
+}
+
+/* The drop counter is 16 bits wide, so read it until two reads agree instead of masking interrupts */
+uint16_t bmRing_getDrops(bm_ring_t *ring)
+{
+    uint16_t drops;
+
+    do
+    {
+        drops = ring->drops;
+    } while(drops != ring->drops);
+
+    return drops;
+}
+
+void bmEventQueue_init(void)
+{
+    bmRing_init(&eventRing, CFG_EVENT_QUEUE_SIZE);
+}
+
+/* Called from interrupt context by the event handler */
+bool bmEventQueue_push(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    uint8_t slot = bmRing_writeSlot(&eventRing);
+
+    if(slot == BM_RING_NO_SLOT)
+    {
+        return false;
+    }
+
+    eventBuffer[slot] = *record;
+    bmRing_publish(&eventRing);
+
+    return true;
+}
+
+/* True when at least one event is waiting; only reads the two single-byte indices */
+bool bmEventQueue_pending(void)
+{
+    return eventRing.head != eventRing.tail;
+}
+
+/* Moves the oldest queued event into record; returns false when the queue is empty */
+bool bmEventQueue_pop(BUTTON_MATRIX_eventRecord_t *record)
+{
+    uint8_t slot = bmRing_readSlot(&eventRing);
+
+    if(slot == BM_RING_NO_SLOT)
+    {
+        return false;
+    }
+
+    *record = eventBuffer[slot];
+    bmRing_release(&eventRing);
+
+    return true;
+}
+
+/* Copies up to max queued events into buffer and returns how many were copied */
+uint8_t bmEventQueue_read(BUTTON_MATRIX_eventRecord_t *buffer, uint8_t max)
+{
+    uint8_t count = 0;
+
+    while((count < max) && bmEventQueue_pop(&buffer[count]))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/* Number of events lost because the queue was full */
+uint16_t bmEventQueue_getDrops(void)
+{
+    return bmRing_getDrops(&eventRing);
+}
+
+/* Largest number of events that were waiting in the queue at the same time */
+uint8_t bmEventQueue_getHighWater(void)
+{
+    return eventRing.high_water;
+}
@@ -0,0 +1,112 @@
+/**
+ * \file button_matrix_queue.h
+ *
+ * \brief Button Matrix single-producer/single-consumer event queue.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_QUEUE_H
+#define	BM_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+
+#if (CFG_EVENT_QUEUE_SIZE < 2) || (CFG_EVENT_QUEUE_SIZE > 128) || \
+    ((CFG_EVENT_QUEUE_SIZE & (CFG_EVENT_QUEUE_SIZE - 1)) != 0)
+#error "CFG_EVENT_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+
+/* Returned by the ring functions when there is no slot to write or read */
+#define BM_RING_NO_SLOT         0xFF
+
+/* Keeps the compiler from moving slot accesses across an index update */
+#define BM_RING_BARRIER()       __asm__ __volatile__ ("" ::: "memory")
+
+/*
+ * Index-only ring: the indices run freely over 0..255 and are masked on access.
+ * Each index is a single byte written by only one side, so no interrupt
+ * masking is needed as long as there is one producer and one consumer.
+ */
+typedef struct {
+    volatile uint8_t head;          /* written by the producer only */
+    volatile uint8_t tail;          /* written by the consumer only */
+    uint8_t mask;                   /* ring size - 1 */
+    volatile uint8_t high_water;    /* written by the producer only */
+    volatile uint16_t drops;        /* written by the producer only */
+} bm_ring_t;
+
+/* Key codes seen by the event handler: the physical keys, or the logical codes of the keymap */
+#if CFG_KEYMAP
+#if (CFG_KEYMAP_CODES < 1) || (CFG_KEYMAP_CODES > 32)
+#error "CFG_KEYMAP_CODES must be between 1 and 32"
+#endif
+#define BM_KEY_CODES            CFG_KEYMAP_CODES
+#else
+#define BM_KEY_CODES            (CFG_ROWS * CFG_COLUMNS)
+#endif
+
+/* One bit per key, bit (key - 1) set while the key is pressed */
+#if ((CFG_ROWS * CFG_COLUMNS) <= 16) && (BM_KEY_CODES <= 16)
+typedef uint16_t BUTTON_MATRIX_state_t;
+#elif (CFG_ROWS * CFG_COLUMNS) <= 32
+typedef uint32_t BUTTON_MATRIX_state_t;
+#else
+#error "The button matrix state bitmap supports up to 32 keys"
+#endif
+
+#if (CFG_MAX_CHORD_KEYS < 2) || (CFG_MAX_CHORD_KEYS > BM_KEY_CODES)
+#error "CFG_MAX_CHORD_KEYS must be between 2 and the number of keys"
+#endif
+
+typedef struct {
+    uint8_t event;
+    uint8_t btn1;
+    uint8_t btn2;
+    BUTTON_MATRIX_state_t keys;     /* every button of the chord, bit (button - 1) */
+    uint32_t timestamp;             /* RTC ticks (1/32768 s) when the event happened */
+    uint16_t duration;              /* ms the chord was held, saturates at 65535 */
+    uint8_t count;                  /* taps of a multi-tap sequence, pattern id of SEQUENCE, 0 for the other events */
+} BUTTON_MATRIX_eventRecord_t;
+
+void bmRing_init(bm_ring_t *ring, uint8_t size);
+uint8_t bmRing_writeSlot(bm_ring_t *ring);
+void bmRing_publish(bm_ring_t *ring);
+uint8_t bmRing_readSlot(bm_ring_t *ring);
+void bmRing_release(bm_ring_t *ring);
+uint16_t bmRing_getDrops(bm_ring_t *ring);
+
+void bmEventQueue_init(void);
+bool bmEventQueue_push(const BUTTON_MATRIX_eventRecord_t *record);
+bool bmEventQueue_pending(void);
+bool bmEventQueue_pop(BUTTON_MATRIX_eventRecord_t *record);
+uint8_t bmEventQueue_read(BUTTON_MATRIX_eventRecord_t *buffer, uint8_t max);
+uint16_t bmEventQueue_getDrops(void);
+uint8_t bmEventQueue_getHighWater(void);
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_QUEUE_H */
@@ -0,0 +1,227 @@
+/**
+ * \file button_matrix_sequence.c
+ *
+ * \brief Button Matrix chord and key-sequence recognizer.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "button_matrix_sequence.h"
+#include "button_matrix_timer.h"
+
+/*
+ * The pattern table is sorted by its steps, so all the patterns that share
+ * the steps seen so far form one contiguous range. That range is the current
+ * node of an implicit trie: each new step narrows it with two binary searches,
+ * so a step costs O(log n) flash reads whatever the number of patterns.
+ *
+ * A step that does not continue the range follows the failure link of the
+ * trie: the longest later part of the steps seen so far that, followed by
+ * the new step, still starts a pattern. The trie is implicit, so the link is
+ * found by narrowing again from the whole table, dropping the oldest step
+ * each time; that costs at most CFG_SEQUENCE_MAX_STEPS^2 / 2 narrowings.
+ */
+
+static const bm_sequence_t *sequenceTable;
+static uint16_t sequenceCount;
+static uint16_t rangeFirst;                   /* first pattern that matches the steps so far */
+static uint16_t rangeEnd;                     /* one past the last pattern that matches */
+static uint8_t depth;                         /* steps matched so far, 0 when no sequence runs */
+static BUTTON_MATRIX_state_t steps[CFG_SEQUENCE_MAX_STEPS];    /* keys of the steps matched so far */
+static uint32_t stepTimes[CFG_SEQUENCE_MAX_STEPS];             /* timestamps of the steps matched so far */
+
+static BUTTON_MATRIX_state_t bmSequence_readStep(uint16_t index, uint8_t step)
+{
+    BUTTON_MATRIX_state_t keys;
+    
+    BM_FLASH_READ(&keys, &sequenceTable[index].steps[step], sizeof(keys));
+    return keys;
+}
+
+static uint8_t bmSequence_readLength(uint16_t index)
+{
+    return BM_FLASH_READ_BYTE(&sequenceTable[index].length);
+}
+
+/* First pattern in [first, end) whose step at depth is above keys, or equal to keys when or_equal */
+static uint16_t bmSequence_bound(uint16_t first, uint16_t end, BUTTON_MATRIX_state_t keys, bool or_equal)
+{
+    uint16_t middle;
+    BUTTON_MATRIX_state_t step;
+    
+    while(first < end)
+    {
+        middle = first + ((end - first) >> 1);
+        step = bmSequence_readStep(middle, depth);
+        if((step < keys) || (!or_equal && (step == keys)))
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+    
+    return first;
+}
+
+/* Narrows the range to the patterns whose next step is keys; returns false when none is left */
+static bool bmSequence_narrow(BUTTON_MATRIX_state_t keys)
+{
+    uint16_t first = bmSequence_bound(rangeFirst, rangeEnd, keys, true);
+    uint16_t end = bmSequence_bound(first, rangeEnd, keys, false);
+    
+    if(first == end)
+    {
+        return false;
+    }
+    
+    rangeFirst = first;
+    rangeEnd = end;
+    depth++;
+    
+    return true;
+}
+
+/* Narrows the whole table with count steps from steps[from], then keys; returns false when none is left */
+static bool bmSequence_retry(uint8_t from, uint8_t count, BUTTON_MATRIX_state_t keys)
+{
+    depth = 0;
+    rangeFirst = 0;
+    rangeEnd = sequenceCount;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!bmSequence_narrow(steps[from + i]))
+        {
+            return false;
+        }
+    }
+    
+    return bmSequence_narrow(keys);
+}
+
+/* Order of two patterns by their steps; a pattern sorts before the longer ones it starts */
+static int8_t bmSequence_compare(uint16_t a, uint16_t b, bool *prefix)
+{
+    uint8_t length_a = bmSequence_readLength(a);
+    uint8_t length_b = bmSequence_readLength(b);
+    BUTTON_MATRIX_state_t step_a, step_b;
+    
+    for(uint8_t i = 0; (i < length_a) && (i < length_b); i++)
+    {
+        step_a = bmSequence_readStep(a, i);
+        step_b = bmSequence_readStep(b, i);
+        if(step_a != step_b)
+        {
+            return (step_a < step_b) ? -1 : 1;
+        }
+    }
+    
+    *prefix = true;
+    return (length_a < length_b) ? -1 : ((length_a > length_b) ? 1 : 0);
+}
+
+/*
+ * Sets the pattern table, which has to live in flash (BM_FLASH)
+ * Returns false, and disables the recognizer, when the table is not sorted by
+ * its steps, has an empty or too long pattern, or has a pattern that starts
+ * another one (the longer pattern could never be matched).
+ */
+bool BUTTON_MATRIX_setSequenceTable(const bm_sequence_t *table, uint16_t count)
+{
+    bool prefix = false;
+    uint8_t length;
+    
+    sequenceTable = table;
+    sequenceCount = count;
+    for(uint16_t i = 0; i < count; i++)
+    {
+        length = bmSequence_readLength(i);
+        if((length == 0) || (length > CFG_SEQUENCE_MAX_STEPS) || (BM_FLASH_READ_BYTE(&table[i].id) == BM_SEQUENCE_NO_MATCH) ||
+           ((i > 0) && ((bmSequence_compare(i - 1, i, &prefix) >= 0) || prefix)))
+        {
+            sequenceCount = 0;
+            break;
+        }
+    }
+    bmSequence_reset();
+    
+    return (sequenceCount == count);
+}
+
+/* Forgets the steps seen so far */
+void bmSequence_reset(void)
+{
+    depth = 0;
+}
+
+/*
+ * Feeds one short press or short chord, with the time it was reported
+ * A step that comes more than CFG_SEQUENCE_TIMEOUT after the previous one
+ * restarts the recognizer from that step. A step that no pattern continues
+ * with keeps the longest later part of the steps that a pattern still starts
+ * with, so S16 S16 S16 S13 matches S16 S16 S13.
+ * Returns the id of the completed pattern and its first step time in start,
+ * or BM_SEQUENCE_NO_MATCH.
+ */
+uint8_t bmSequence_step(BUTTON_MATRIX_state_t keys, uint32_t timestamp, uint32_t *start)
+{
+    uint8_t matched;
+    uint8_t from;
+    
+    if((depth != 0) && ((timestamp - stepTimes[depth - 1]) > BM_TIMER_MS(CFG_SEQUENCE_TIMEOUT)))
+    {
+        depth = 0;
+    }
+    
+    if((depth == 0) || !bmSequence_narrow(keys))
+    {
+        matched = depth;
+        from = (matched != 0) ? 1 : 0;
+        while(!bmSequence_retry(from, matched - from, keys))
+        {
+            if(from == matched)
+            {
+                depth = 0;
+                return BM_SEQUENCE_NO_MATCH;
+            }
+            from++;
+        }
+        
+        for(uint8_t i = 0; (i + 1) < depth; i++)
+        {
+            steps[i] = steps[from + i];
+            stepTimes[i] = stepTimes[from + i];
+        }
+    }
+    
+    steps[depth - 1] = keys;
+    stepTimes[depth - 1] = timestamp;
+    
+    /* No pattern starts another one, so a complete pattern is alone in its range */
+    if(bmSequence_readLength(rangeFirst) == depth)
+    {
+        depth = 0;
+        *start = stepTimes[0];
+        return BM_FLASH_READ_BYTE(&sequenceTable[rangeFirst].id);
+    }
+    
+    return BM_SEQUENCE_NO_MATCH;
+}
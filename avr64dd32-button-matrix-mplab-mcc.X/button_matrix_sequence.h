@@ -0,0 +1,64 @@
+/**
+ * \file button_matrix_sequence.h
+ *
+ * \brief Button Matrix chord and key-sequence recognizer header file.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_SEQUENCE_H
+#define	BM_SEQUENCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+#include "button_matrix_hal.h"
+#include "button_matrix_queue.h"
+
+/* Bit of key (1 based) in a BUTTON_MATRIX_state_t, to build the steps of a pattern */
+#define BUTTON_MATRIX_KEY(key)              ((BUTTON_MATRIX_state_t)1 << ((key) - 1))
+
+/* Returned by bmSequence_step when no pattern is complete */
+#define BM_SEQUENCE_NO_MATCH                0
+
+/*
+ * One pattern: length steps, each the keys bitmap of a short press (one
+ * button) or of a short chord (several buttons). A single step with several
+ * keys is a plain chord. The id (1 to 255) is reported with the SEQUENCE event,
+ * and several patterns may share an id.
+ */
+typedef struct {
+    uint8_t id;
+    uint8_t length;
+    BUTTON_MATRIX_state_t steps[CFG_SEQUENCE_MAX_STEPS];
+} bm_sequence_t;
+
+bool BUTTON_MATRIX_setSequenceTable(const bm_sequence_t *table, uint16_t count);
+void bmSequence_reset(void);
+uint8_t bmSequence_step(BUTTON_MATRIX_state_t keys, uint32_t timestamp, uint32_t *start);
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_SEQUENCE_H */
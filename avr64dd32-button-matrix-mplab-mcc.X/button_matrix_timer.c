@@ -0,0 +1,363 @@
+/**
+ * \file button_matrix_timer.c
+ *
+ * \brief Button Matrix one-shot software timers on the RTC compare channel.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include "button_matrix_hal.h"
+#include "button_matrix_profile.h"
+#include "button_matrix_timer.h"
+
+/*
+ * The RTC runs freely over its full 16-bit period and the overflow interrupt
+ * extends it to a 32-bit tick count. Running timers are kept in a list sorted
+ * by deadline, and the compare channel is always set to the earliest one.
+ *
+ * A compare write takes 2 to 3 RTC cycles (61..92 us, 245..370 CPU cycles at
+ * 4 MHz) to synchronize, and the next one has to wait for it with interrupts
+ * off.
+ * Between bmTimer_hold and bmTimer_release the channel is written once, at
+ * the release, however many timers the handler in between starts or stops.
+ */
+
+/* Deadlines closer than this are moved out, so the compare write can synchronize before the match */
+#define BM_TIMER_MIN_LEAD           4
+
+typedef struct {
+    uint32_t deadline;
+    bmTimer_cb_t callback;
+    uint8_t arg;
+    uint8_t next;
+#if CFG_DEFERRED_DISPATCH
+    uint8_t generation;     /* changes on every start and stop, so an expiry can be recognized as stale */
+#endif
+} bm_timer_t;
+
+static bm_timer_t timers[BM_TIMER_SLOTS];
+static uint8_t timerHead;
+static volatile uint16_t rtcHigh;
+static uint8_t programHold;
+static bool programPending;
+#if CFG_DEFERRED_DISPATCH
+static bmTimer_expired_cb_t expiredHandler;
+#endif
+
+/* Tick count; must be called with interrupts disabled */
+static uint32_t bmTimer_read(void)
+{
+    uint16_t high = rtcHigh;
+    uint16_t low = bmHal_readTicks();
+    
+    /* The counter wrapped but the overflow interrupt has not been served yet */
+    if(bmHal_ticksOverflowPending() && (low < 0x8000))
+    {
+        high++;
+    }
+    
+    return ((uint32_t)high << 16) | low;
+}
+
+uint32_t bmTimer_now(void)
+{
+    uint32_t now;
+    
+    BM_HAL_ENTER_CRITICAL();
+    now = bmTimer_read();
+    BM_HAL_EXIT_CRITICAL();
+    
+    return now;
+}
+
+/* Converts a tick interval to milliseconds, saturating at 65535 ms */
+uint16_t bmTimer_toMs(uint32_t ticks)
+{
+    if(ticks >= BM_TIMER_MS(UINT16_MAX))
+    {
+        return UINT16_MAX;
+    }
+    
+    return (uint16_t)((ticks * 1000UL) / BM_TIMER_TICKS_PER_S);
+}
+
+/* Waits until the compare channel can be written again; the profiler times the stall */
+static void bmTimer_syncCompare(void)
+{
+    if(bmHal_tickCompareBusy())
+    {
+        BM_PROFILE_BEGIN();
+        
+        while(bmHal_tickCompareBusy())
+        {
+            ;
+        }
+        
+        BM_PROFILE_END(BM_PROFILE_RTC_SYNC);
+    }
+}
+
+/* Sets the compare channel to the earliest deadline if it falls in the current RTC period */
+static void bmTimer_program(void)
+{
+    uint32_t now;
+    uint32_t deadline;
+    
+    if(programHold != 0)
+    {
+        programPending = true;
+        return;
+    }
+    programPending = false;
+    
+    if(timerHead == BM_TIMER_NO_SLOT)
+    {
+        bmHal_disableTickCompare();
+        return;
+    }
+    
+    now = bmTimer_read();
+    deadline = timers[timerHead].deadline;
+    
+    if((int32_t)(deadline - now) < BM_TIMER_MIN_LEAD)
+    {
+        deadline = now + BM_TIMER_MIN_LEAD;
+    }
+    
+    if((deadline - now) <= 0xFFFF)
+    {
+        bmTimer_syncCompare();
+        bmHal_setTickCompare((uint16_t)deadline);
+    }
+    else
+    {
+        /* Too far away; the overflow interrupt will program it later */
+        bmHal_disableTickCompare();
+    }
+}
+
+/* Takes the slot out of the sorted list; returns true if it was the earliest */
+static bool bmTimer_unlink(uint8_t slot)
+{
+    uint8_t *link = &timerHead;
+    
+    while(*link != BM_TIMER_NO_SLOT)
+    {
+        if(*link == slot)
+        {
+            *link = timers[slot].next;
+            timers[slot].next = BM_TIMER_NO_SLOT;
+            return (link == &timerHead);
+        }
+        link = &timers[*link].next;
+    }
+    
+    return false;
+}
+
+/* Inserts the slot behind all deadlines that are not later than its own */
+static void bmTimer_link(uint8_t slot)
+{
+    uint8_t *link = &timerHead;
+    uint32_t now = bmTimer_read();
+    uint32_t remaining = timers[slot].deadline - now;
+    
+    while((*link != BM_TIMER_NO_SLOT) && ((int32_t)(timers[*link].deadline - now) <= (int32_t)remaining))
+    {
+        link = &timers[*link].next;
+    }
+    
+    timers[slot].next = *link;
+    *link = slot;
+}
+
+/* Puts the slot back in the list with a new deadline; must be called with interrupts disabled */
+static void bmTimer_arm(uint8_t slot, uint32_t deadline)
+{
+    bmTimer_unlink(slot);
+    timers[slot].deadline = deadline;
+#if CFG_DEFERRED_DISPATCH
+    timers[slot].generation++;
+#endif
+    bmTimer_link(slot);
+    
+    if(timerHead == slot)
+    {
+        bmTimer_program();
+    }
+}
+
+/* Arms a one-shot timer, restarting it if it was already running; the callback runs in the RTC interrupt */
+void bmTimer_start(uint8_t slot, uint32_t delay, bmTimer_cb_t callback, uint8_t arg)
+{
+    BM_HAL_ENTER_CRITICAL();
+    
+    timers[slot].callback = callback;
+    timers[slot].arg = arg;
+    bmTimer_arm(slot, bmTimer_read() + delay);
+    
+    BM_HAL_EXIT_CRITICAL();
+}
+
+/* Same as bmTimer_start, with a deadline counted from the tick count base instead of from now */
+void bmTimer_startAt(uint8_t slot, uint32_t base, uint32_t delay, bmTimer_cb_t callback, uint8_t arg)
+{
+    BM_HAL_ENTER_CRITICAL();
+    
+    timers[slot].callback = callback;
+    timers[slot].arg = arg;
+    bmTimer_arm(slot, base + delay);
+    
+    BM_HAL_EXIT_CRITICAL();
+}
+
+/* Rearms an expired timer one period after its previous deadline, so a periodic timer does not drift */
+void bmTimer_restart(uint8_t slot, uint32_t period)
+{
+    BM_HAL_ENTER_CRITICAL();
+    
+    bmTimer_arm(slot, timers[slot].deadline + period);
+    
+    BM_HAL_EXIT_CRITICAL();
+}
+
+/* Deadline the slot was last armed with; in its callback, the time the timer expired */
+uint32_t bmTimer_deadline(uint8_t slot)
+{
+    uint32_t deadline;
+    
+    BM_HAL_ENTER_CRITICAL();
+    deadline = timers[slot].deadline;
+    BM_HAL_EXIT_CRITICAL();
+    
+    return deadline;
+}
+
+/* Holds back the compare writes until bmTimer_release; interrupt context only, the calls nest */
+void bmTimer_hold(void)
+{
+    programHold++;
+}
+
+/* Writes the compare channel once if a timer started or stopped since bmTimer_hold */
+void bmTimer_release(void)
+{
+    programHold--;
+    if(programPending)
+    {
+        bmTimer_program();
+    }
+}
+
+void bmTimer_stop(uint8_t slot)
+{
+    BM_HAL_ENTER_CRITICAL();
+    
+#if CFG_DEFERRED_DISPATCH
+    timers[slot].generation++;
+#endif
+    if(bmTimer_unlink(slot))
+    {
+        bmTimer_program();
+    }
+    
+    BM_HAL_EXIT_CRITICAL();
+}
+
+#if CFG_DEFERRED_DISPATCH
+/* Expired timers are passed to handler, in the RTC interrupt, instead of running their callbacks */
+void bmTimer_setExpiredHandler(bmTimer_expired_cb_t handler)
+{
+    expiredHandler = handler;
+}
+
+/* Runs the callback of an expiry passed to the expired handler, unless the slot was started or stopped since */
+void bmTimer_run(uint8_t slot, uint8_t generation)
+{
+    bmTimer_cb_t callback = NULL;
+    uint8_t arg = 0;
+    
+    BM_HAL_ENTER_CRITICAL();
+    if(timers[slot].generation == generation)
+    {
+        callback = timers[slot].callback;
+        arg = timers[slot].arg;
+    }
+    BM_HAL_EXIT_CRITICAL();
+    
+    if(callback != NULL)
+    {
+        callback(arg);
+    }
+}
+#endif
+
+/* RTC overflow: extends the tick count, and the earliest deadline may now be in range */
+static void bmTimer_overflow_Cb(void)
+{
+    BM_PROFILE_BEGIN();
+    
+    rtcHigh++;
+    bmTimer_program();
+    
+    BM_PROFILE_END(BM_PROFILE_RTC);
+}
+
+/* RTC compare: runs the callbacks of all expired timers, or hands them to the expired handler, then sets up the next deadline */
+static void bmTimer_compare_Cb(void)
+{
+    BM_PROFILE_BEGIN();
+    uint8_t slot;
+    
+    bmTimer_hold();
+    while((timerHead != BM_TIMER_NO_SLOT) && ((int32_t)(timers[timerHead].deadline - bmTimer_read()) <= 0))
+    {
+        slot = timerHead;
+        timerHead = timers[slot].next;
+        timers[slot].next = BM_TIMER_NO_SLOT;
+#if CFG_DEFERRED_DISPATCH
+        if(expiredHandler != NULL)
+        {
+            expiredHandler(slot, timers[slot].generation);
+            continue;
+        }
+#endif
+        timers[slot].callback(timers[slot].arg);
+    }
+    
+    programPending = true;
+    bmTimer_release();
+    
+    BM_PROFILE_END(BM_PROFILE_RTC);
+}
+
+void bmTimer_init(void)
+{
+    timerHead = BM_TIMER_NO_SLOT;
+    rtcHigh = 0;
+    programHold = 0;
+    programPending = false;
+    for(uint8_t i = 0; i < BM_TIMER_SLOTS; i++)
+    {
+        timers[i].next = BM_TIMER_NO_SLOT;
+    }
+    
+    bmHal_startTicks(bmTimer_overflow_Cb, bmTimer_compare_Cb);
+}
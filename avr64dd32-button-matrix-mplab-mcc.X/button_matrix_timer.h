@@ -0,0 +1,74 @@
+/**
+ * \file button_matrix_timer.h
+ *
+ * \brief Button Matrix one-shot software timers on the RTC compare channel.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_TIMER_H
+#define	BM_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+#include "button_matrix_queue.h"
+
+/* RTC ticks per second, the RTC counts the 32.768 kHz internal oscillator */
+#define BM_TIMER_TICKS_PER_S        32768UL
+
+/* Converts a time in milliseconds to RTC ticks */
+#define BM_TIMER_MS(ms)             ((uint32_t)(((uint32_t)(ms) * BM_TIMER_TICKS_PER_S) / 1000UL))
+
+/* Timer slots: one long-press deadline per key code, then the auto-repeat and tap window deadlines when enabled */
+#define BM_TIMER_SLOT_LONG_PRESS(button)    ((button) - 1)
+#define BM_TIMER_SLOT_REPEAT        (BM_KEY_CODES)
+#define BM_TIMER_SLOT_TAP           (BM_TIMER_SLOT_REPEAT + ((CFG_AUTO_REPEAT) ? 1 : 0))
+#define BM_TIMER_SLOTS              (BM_TIMER_SLOT_TAP + ((CFG_MULTI_TAP) ? 1 : 0))
+
+#define BM_TIMER_NO_SLOT            0xFF
+
+typedef void (*bmTimer_cb_t)(uint8_t arg);
+typedef void (*bmTimer_expired_cb_t)(uint8_t slot, uint8_t generation);
+
+void bmTimer_init(void);
+uint32_t bmTimer_now(void);
+uint16_t bmTimer_toMs(uint32_t ticks);
+void bmTimer_start(uint8_t slot, uint32_t delay, bmTimer_cb_t callback, uint8_t arg);
+void bmTimer_startAt(uint8_t slot, uint32_t base, uint32_t delay, bmTimer_cb_t callback, uint8_t arg);
+void bmTimer_restart(uint8_t slot, uint32_t period);
+uint32_t bmTimer_deadline(uint8_t slot);
+void bmTimer_stop(uint8_t slot);
+void bmTimer_hold(void);
+void bmTimer_release(void);
+
+#if CFG_DEFERRED_DISPATCH
+void bmTimer_setExpiredHandler(bmTimer_expired_cb_t handler);
+void bmTimer_run(uint8_t slot, uint8_t generation);
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_TIMER_H */
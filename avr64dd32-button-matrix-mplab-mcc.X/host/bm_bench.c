@@ -0,0 +1,200 @@
+/**
+ * \file bm_bench.c
+ *
+ * \brief Host benchmark of the button matrix stack on the simulated matrix.
+ *
+ * Types random strokes, chords and long holds on the simulated matrix, runs
+ * the scan, the debounce and the classifier against the virtual clock, and
+ * reports the events and the host time spent per scan.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "bm_sim.h"
+
+#define BM_BENCH_BATCH          16
+#define BM_BENCH_KEYS           (CFG_ROWS * CFG_COLUMNS)
+
+static uint64_t eventCount[BM_EVENT_TYPES];
+static bool verbose;
+static uint32_t seed = 1;
+
+/* xorshift32, so a seed gives the same strokes on every host */
+static uint32_t bmBench_random(uint32_t range)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return seed % range;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-v] [-t SECONDS] [-s SEED]\n"
+            "  Types random keys on the simulated matrix for SECONDS of virtual time\n"
+            "  (600 by default) and reports the events and the host time per scan.\n"
+            "  -v  print every event\n", name);
+}
+
+/* Runs the simulation up to time, then handles the events like the main loop would */
+static void bmBench_runUntil(uint64_t time)
+{
+    BUTTON_MATRIX_eventRecord_t events[BM_BENCH_BATCH];
+    uint8_t count;
+    
+    bmSim_runUntil(time);
+    BUTTON_MATRIX_Tasks();
+    
+    while((count = BUTTON_MATRIX_readEvents(events, BM_BENCH_BATCH)) != 0)
+    {
+        for(uint8_t i = 0; i < count; i++)
+        {
+            eventCount[events[i].event]++;
+            if(verbose)
+            {
+                printf("%10u %-20s %2u %2u keys=%04lx %5u ms x%u\n", events[i].timestamp, bmSim_eventNames[events[i].event],
+                       events[i].btn1, events[i].btn2, (unsigned long)events[i].keys, events[i].duration, events[i].count);
+            }
+        }
+    }
+}
+
+/* One stroke: a key, sometimes a two key chord, held for a short, medium or long time */
+static void bmBench_stroke(void)
+{
+    uint8_t first = (uint8_t)(bmBench_random(BM_BENCH_KEYS) + 1);
+    uint8_t second = (uint8_t)(bmBench_random(BM_BENCH_KEYS) + 1);
+    bool chord = (bmBench_random(10) == 0) && (second != first);
+    uint32_t kind = bmBench_random(20);
+    uint64_t hold;
+    
+    if(kind == 0)
+    {
+        hold = BM_SIM_MS(CFG_LONG_PRESS_TIME + 100 + bmBench_random(1000));
+    }
+    else if(kind < 3)
+    {
+        hold = BM_SIM_MS(300 + bmBench_random(1200));
+    }
+    else
+    {
+        hold = BM_SIM_MS(40 + bmBench_random(260));
+    }
+    
+    bmSim_setKey(first, true);
+    if(chord)
+    {
+        bmBench_runUntil(bmSim_now() + BM_SIM_MS(bmBench_random(30)));
+        bmSim_setKey(second, true);
+    }
+    bmBench_runUntil(bmSim_now() + hold);
+    bmSim_setKey(first, false);
+    if(chord)
+    {
+        bmSim_setKey(second, false);
+    }
+    bmBench_runUntil(bmSim_now() + BM_SIM_MS(20 + bmBench_random(400)));
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t duration = BM_SIM_S(600);
+    struct timespec start;
+    struct timespec end;
+    bm_sim_stats_t stats;
+    uint64_t events = 0;
+    double elapsed;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "vt:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'v':
+                verbose = true;
+                break;
+            case 't':
+                duration = BM_SIM_S(strtoull(optarg, NULL, 0));
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                if(seed == 0)
+                {
+                    seed = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    
+    bmSim_reset();
+    BUTTON_MATRIX_init();
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(bmSim_now() < duration)
+    {
+        bmBench_stroke();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    elapsed = (double)(end.tv_sec - start.tv_sec) + ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+    bmSim_getStats(&stats);
+    
+    for(uint8_t i = 0; i < BM_EVENT_TYPES; i++)
+    {
+        if(eventCount[i] != 0)
+        {
+            printf("%-20s %10llu\n", bmSim_eventNames[i], (unsigned long long)eventCount[i]);
+        }
+        events += eventCount[i];
+    }
+    printf("events               %10llu (%u dropped)\n", (unsigned long long)events, BUTTON_MATRIX_getDroppedEvents());
+    printf("virtual time         %10.1f s\n", (double)bmSim_now() / 1e9);
+    printf("scans                %10llu (%llu RTC, %llu wake interrupts)\n", (unsigned long long)stats.scans,
+           (unsigned long long)(stats.tickOverflows + stats.tickCompares), (unsigned long long)stats.rowWakes);
+    printf("host time            %10.3f s\n", elapsed);
+    if((elapsed > 0) && (stats.scans != 0))
+    {
+        printf("scans per second     %10.0f\n", (double)stats.scans / elapsed);
+        printf("host time per scan   %10.1f ns\n", (elapsed * 1e9) / (double)stats.scans);
+    }
+#if CFG_PROFILER
+    /* The host profile timer counts nanoseconds; the count of each site stops at 65535 runs */
+    for(uint8_t site = 0; site < BM_PROFILE_SITES; site++)
+    {
+        BUTTON_MATRIX_profile_t profile;
+        
+        if(BUTTON_MATRIX_getProfile(site, &profile) && (profile.count != 0))
+        {
+            printf("profile site %u       %10u runs, %u..%u ns, mean %.1f ns\n", site, profile.count, profile.min, profile.max,
+                   (double)profile.sum / (double)profile.count);
+        }
+    }
+#endif
+    
+    return 0;
+}
@@ -0,0 +1,185 @@
+#!/bin/sh
+# Builds the host checks with several button_matrix_config.h settings, each in
+# its own copy of the library under check/: the debounce engines against each
+# other, the RTC timer service against a model of its slots, the event
+# classifier against the three-slot classifier it replaced, the event queue
+# and the optional event types on directed strokes, and bm_replay on the
+# traces under traces/ against their expected metrics.
+#   ./bm_check.sh [SCANS]     SCANS random scans per debounce setting, 2000000 by default
+# Exits with 1 when a check fails.
+
+cd "$(dirname "$0")" || exit 2
+
+FIRMWARE_DIR=${FIRMWARE_DIR:-..}
+BUILD=check
+SCANS=${1:-2000000}
+failures=0
+
+# configure NAME SETTING...: copies the library and the host sources to check/NAME and applies each CFG_X=VALUE
+configure()
+{
+    dir=$BUILD/$1
+    shift
+    rm -rf "$dir"
+    mkdir -p "$dir/host"
+    cp "$FIRMWARE_DIR"/button_matrix*.[ch] "$dir"
+    cp Makefile ./*.c ./*.h "$dir/host"
+    for setting in "$@"; do
+        name=${setting%%=*}
+        if ! grep -q "^#define $name " "$dir/button_matrix_config.h"; then
+            echo "no setting $name in button_matrix_config.h" >&2
+            exit 2
+        fi
+        sed -i -E "s|^(#define $name +)[^ /]+|\1${setting#*=}|" "$dir/button_matrix_config.h"
+    done
+}
+
+# field FILE LABEL: the text after the label of a bm_check_debounce line
+field()
+{
+    sed -n "s/^$2  *//p" "$1"
+}
+
+# scanTime FILE: host ns per scan on random rows and on the released matrix, as RANDOM/RELEASED
+scanTime()
+{
+    field "$1" "host time per scan" | sed -E 's| ns random rows, |/|; s| ns released||'
+}
+
+# debounce LABEL SETTING...: runs both debounce engines on the same random rows and compares the digests
+debounce()
+{
+    label=$1
+    shift
+    for engine in COUNTER VERTICAL; do
+        configure "$label-$engine" CFG_DEBOUNCE_ALGORITHM=BM_DEBOUNCE_$engine "$@"
+        make -s -C "$BUILD/$label-$engine/host" bm_check_debounce || exit 2
+        "$BUILD/$label-$engine/host/bm_check_debounce" -n "$SCANS" > "$BUILD/$label-$engine.txt" || exit 2
+    done
+
+    counter=$BUILD/$label-COUNTER.txt
+    vertical=$BUILD/$label-VERTICAL.txt
+    if [ "$(field "$counter" "state digest")" = "$(field "$vertical" "state digest")" ] &&
+       [ "$(field "$counter" "state changes")" = "$(field "$vertical" "state changes")" ]; then
+        result=same
+    else
+        result=DIFFERENT
+        failures=$((failures + 1))
+    fi
+    printf "%-28s %8s %6s %6s %15s %15s  %s\n" "$label" "$(field "$counter" "state changes")" \
+           "$(field "$counter" "debounce RAM" | cut -d' ' -f1)" "$(field "$vertical" "debounce RAM" | cut -d' ' -f1)" \
+           "$(scanTime "$counter")" "$(scanTime "$vertical")" "$result"
+}
+
+# classifier LABEL SETTING...: feeds random edges to the classifier and to the one it replaced and compares the events
+classifier()
+{
+    label=$1
+    shift
+    configure "$label" "$@"
+    make -s -C "$BUILD/$label/host" bm_check_classifier || exit 2
+    if "$BUILD/$label/host/bm_check_classifier" > "$BUILD/$label.txt"; then
+        result=pass
+    else
+        result=FAIL
+        failures=$((failures + 1))
+    fi
+    printf "%-28s %s events compared, %s crowds  %s\n" "$label" "$(field "$BUILD/$label.txt" "events compared")" \
+           "$(field "$BUILD/$label.txt" "crowds of 4 to 6")" "$result"
+}
+
+# events LABEL SETTING...: runs the directed cases of bm_check_events that the settings compile in
+events()
+{
+    label=$1
+    shift
+    configure "$label" "$@"
+    make -s -C "$BUILD/$label/host" bm_check_events || exit 2
+    if "$BUILD/$label/host/bm_check_events" > "$BUILD/$label.txt"; then
+        result=pass
+    else
+        result=FAIL
+        failures=$((failures + 1))
+        grep -v -e " pass$" -e "^cases " -e "^failures " "$BUILD/$label.txt"
+    fi
+    printf "%-28s %s cases  %s\n" "$label" "$(field "$BUILD/$label.txt" "cases")" "$result"
+}
+
+# replay TRACE: replays traces/TRACE.txt and compares the metrics, all but the host times, with traces/TRACE.expected
+replay()
+{
+    trace=$1
+    configure "replay"
+    make -s -C "$BUILD/replay/host" bm_replay || exit 2
+    "$BUILD/replay/host/bm_replay" -q "traces/$trace.txt" | grep -v "^host time" > "$BUILD/$trace.txt"
+    if diff "traces/$trace.expected" "$BUILD/$trace.txt" > "$BUILD/$trace.diff"; then
+        result=pass
+    else
+        result=FAIL
+        failures=$((failures + 1))
+        cat "$BUILD/$trace.diff"
+    fi
+    printf "%-28s %s  %s\n" "$trace" "$(field "$BUILD/$trace.txt" "ground truth")" "$result"
+}
+
+# timer LABEL SETTING...: starts and stops the timer slots at random and checks every expiry against a model
+timer()
+{
+    label=$1
+    shift
+    configure "$label" "$@"
+    make -s -C "$BUILD/$label/host" bm_check_timer || exit 2
+    if "$BUILD/$label/host/bm_check_timer" > "$BUILD/$label.txt"; then
+        result=pass
+    else
+        result=FAIL
+        failures=$((failures + 1))
+    fi
+    printf "%-28s %s  %s\n" "$label" "$(field "$BUILD/$label.txt" "expiries" | sed 's/,/ expiries,/')" "$result"
+}
+
+echo "debounce engines over $SCANS scans of random rows; RAM in bytes, host ns per scan on random/released rows"
+printf "%-28s %8s %6s %6s %15s %15s  %s\n" "setting" "changes" "RAM C" "RAM V" "scan C" "scan V" "digests"
+for time in 1 2 3 4 5 6 7; do
+    debounce "time-$time" CFG_DEBOUNCE_TIME=$time
+done
+# Press time, release time and lockout, as P/R/L
+for times in 1/4/0 1/4/3 2/5/2 4/2/1 3/3/7 7/1/7 1/1/1 5/7/4; do
+    press=${times%%/*}
+    release=${times#*/}
+    release=${release%/*}
+    lockout=${times##*/}
+    debounce "press-$press-release-$release-lock-$lockout" CFG_DEBOUNCE_PRESS_TIME=$press CFG_DEBOUNCE_RELEASE_TIME=$release \
+             CFG_DEBOUNCE_LOCKOUT=$lockout
+done
+
+echo
+echo "RTC timer service, random starts and stops over 60000000 ticks"
+timer "timer"
+timer "timer-deferred" CFG_DEFERRED_DISPATCH=1
+
+echo
+echo "event classifier against the three-slot classifier, 300000 random presses and releases"
+classifier "classifier"
+classifier "classifier-deferred" CFG_DEFERRED_DISPATCH=1
+
+echo
+echo "event queue and event types, directed strokes on the virtual clock"
+events "events"
+events "events-deferred" CFG_DEFERRED_DISPATCH=1
+events "events-raw" CFG_RAW_EVENTS=1
+events "events-repeat" CFG_AUTO_REPEAT=1
+events "events-repeat-fixed" CFG_AUTO_REPEAT=1 CFG_REPEAT_ACCELERATION=0
+events "events-tap" CFG_MULTI_TAP=1 CFG_TAP_DELAY_KEYS=0x0002
+events "events-subscribers" CFG_SUBSCRIBERS=4
+events "events-histogram" CFG_LATENCY_HISTOGRAM=1
+
+echo
+echo "trace replay against the expected latency and ground truth metrics"
+replay "mixed_90s"
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "all checks passed"
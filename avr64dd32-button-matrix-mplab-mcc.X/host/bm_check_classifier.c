@@ -0,0 +1,400 @@
+/**
+ * \file bm_check_classifier.c
+ *
+ * \brief Host check of the event classifier against the three-slot classifier
+ *        it replaced.
+ *
+ * Presses and releases random buttons, at most three at a time, with holds
+ * from a few ms to past the long-press time, and feeds the same edges to the
+ * library and to a copy of the classifier of the original demo: three button
+ * slots shifted down on release, one long-press deadline per button. Both
+ * must report the same events with the same buttons. With more than three
+ * buttons held, only the library runs; once every button is released again,
+ * a single press must still report a SHORT_PRESS, so the held count has not
+ * drifted.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bm_sim.h"
+#include "button_matrix_phy.h"
+#include "button_matrix_timer.h"
+
+#define BM_CHECK_KEYS           (CFG_ROWS * CFG_COLUMNS)
+#define BM_CHECK_LOG_SIZE       16
+#define BM_CHECK_EVENT(event, btn1, btn2)   (((uint32_t)(event) << 16) | ((uint32_t)(btn1) << 8) | (btn2))
+
+typedef struct {
+    uint32_t events[BM_CHECK_LOG_SIZE];
+    uint8_t count;
+} bm_check_log_t;
+
+/* The original classifier, with the long-press deadlines kept here instead of on the RTC */
+static struct {
+    int pressed_buttons;
+    bool multiple_event_f;
+    bool long_event_f;
+    bool double_event_f;
+    uint8_t buttons[3];
+    bool running[BM_CHECK_KEYS + 1];
+    uint32_t deadline[BM_CHECK_KEYS + 1];
+} reference;
+
+static bm_check_log_t referenceLog;
+static bm_check_log_t libraryLog;
+static BUTTON_MATRIX_state_t held;
+static uint8_t heldCount;
+static uint32_t seed = 1;
+static uint64_t edges;
+static uint64_t compared;
+static uint64_t eventCount[BM_EVENT_TYPES];
+static uint64_t failures;
+
+/* xorshift32, so a seed gives the same strokes on every host */
+static uint32_t bmCheck_random(uint32_t range)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return seed % range;
+}
+
+static void bmCheck_log(bm_check_log_t *log, BUTTON_MATRIX_event_t event, uint8_t btn1, uint8_t btn2)
+{
+    if(log->count < BM_CHECK_LOG_SIZE)
+    {
+        log->events[log->count] = BM_CHECK_EVENT(event, btn1, btn2);
+    }
+    log->count++;
+}
+
+static void bmCheck_libraryEvent(uint8_t event, uint8_t btn1, uint8_t btn2)
+{
+    bmCheck_log(&libraryLog, event, btn1, btn2);
+    eventCount[event]++;
+}
+
+static void bmReference_timer(uint8_t button)
+{
+    if(reference.multiple_event_f)
+    {
+        return;
+    }
+    
+    if((reference.pressed_buttons == 1) && !reference.double_event_f && (reference.buttons[0] == button))
+    {
+        bmCheck_log(&referenceLog, LONG_PRESS, reference.buttons[0], BM_NULL_BTN);
+        reference.long_event_f = 1;
+    }
+    else if((reference.pressed_buttons == 2) && reference.double_event_f && (reference.buttons[1] == button))
+    {
+        bmCheck_log(&referenceLog, MULTIPLE_LONG_PRESS, reference.buttons[0], reference.buttons[1]);
+        reference.long_event_f = 1;
+    }
+}
+
+/* Runs the reference deadlines that have passed, earliest first, as the RTC compare interrupt does */
+static void bmReference_expire(uint32_t now)
+{
+    uint8_t next;
+    
+    do
+    {
+        next = BM_NULL_BTN;
+        for(uint8_t button = 1; button <= BM_CHECK_KEYS; button++)
+        {
+            if(reference.running[button] && ((int32_t)(now - reference.deadline[button]) >= 0) &&
+               ((next == BM_NULL_BTN) || ((int32_t)(reference.deadline[button] - reference.deadline[next]) < 0)))
+            {
+                next = button;
+            }
+        }
+        if(next != BM_NULL_BTN)
+        {
+            reference.running[next] = false;
+            bmReference_timer(next);
+        }
+    } while(next != BM_NULL_BTN);
+}
+
+static void bmReference_edge(uint8_t button, bool state, uint32_t now)
+{
+    if(state == BM_BUTTON_PRESSED)
+    {
+        switch(reference.pressed_buttons)
+        {
+            case 0:
+            case 1:
+                reference.running[button] = true;
+                reference.deadline[button] = now + BM_TIMER_MS(CFG_LONG_PRESS_TIME);
+                reference.buttons[reference.pressed_buttons] = button;
+                reference.double_event_f = (reference.pressed_buttons == 1);
+                reference.pressed_buttons++;
+                reference.multiple_event_f = 0;
+                reference.long_event_f = 0;
+                break;
+            case 2:
+                bmCheck_log(&referenceLog, ERROR, BM_NULL_BTN, BM_NULL_BTN);
+                reference.buttons[reference.pressed_buttons] = button;
+                reference.pressed_buttons++;
+                reference.multiple_event_f = 1;
+                reference.double_event_f = 0;
+                reference.long_event_f = 0;
+                break;
+            default:
+                reference.multiple_event_f = 1;
+                break;
+        }
+    }
+    else
+    {
+        reference.running[button] = false;
+        if(!reference.long_event_f && !reference.multiple_event_f)
+        {
+            if(reference.double_event_f)
+            {
+                reference.multiple_event_f = 1;
+                bmCheck_log(&referenceLog, MULTIPLE_SHORT_PRESS, reference.buttons[0], reference.buttons[1]);
+            }
+            else
+            {
+                bmCheck_log(&referenceLog, SHORT_PRESS, reference.buttons[reference.pressed_buttons - 1], BM_NULL_BTN);
+            }
+        }
+        
+        for(int i = 0; i < reference.pressed_buttons; i++)
+        {
+            if(reference.buttons[i] == button)
+            {
+                for(int j = i; j < reference.pressed_buttons - 1; j++)
+                {
+                    reference.buttons[j] = reference.buttons[j + 1];
+                }
+                reference.buttons[reference.pressed_buttons - 1] = BM_NULL_BTN;
+                reference.pressed_buttons--;
+            }
+        }
+    }
+}
+
+static void bmCheck_fail(const char *what)
+{
+    if(failures < 10)
+    {
+        printf("FAIL: %s at tick %u:", what, bmTimer_now());
+        for(uint8_t i = 0; (i < libraryLog.count) && (i < BM_CHECK_LOG_SIZE); i++)
+        {
+            printf(" %s %u %u", bmSim_eventNames[libraryLog.events[i] >> 16], (libraryLog.events[i] >> 8) & 0xFF, libraryLog.events[i] & 0xFF);
+        }
+        printf(" | reference:");
+        for(uint8_t i = 0; (i < referenceLog.count) && (i < BM_CHECK_LOG_SIZE); i++)
+        {
+            printf(" %s %u %u", bmSim_eventNames[referenceLog.events[i] >> 16], (referenceLog.events[i] >> 8) & 0xFF, referenceLog.events[i] & 0xFF);
+        }
+        printf("\n");
+    }
+    failures++;
+}
+
+/* Compares the events of the library and of the reference since the last call */
+static void bmCheck_compare(void)
+{
+    bool same = (libraryLog.count == referenceLog.count);
+    
+    for(uint8_t i = 0; same && (i < libraryLog.count) && (i < BM_CHECK_LOG_SIZE); i++)
+    {
+        same = (libraryLog.events[i] == referenceLog.events[i]);
+    }
+    if(!same)
+    {
+        bmCheck_fail("different events");
+    }
+    compared += libraryLog.count;
+    libraryLog.count = 0;
+    referenceLog.count = 0;
+}
+
+/* Advances the virtual clock; the reference follows while at most three buttons are held */
+static void bmCheck_wait(uint64_t time, bool withReference)
+{
+    bmSim_runUntil(bmSim_now() + time);
+    BUTTON_MATRIX_Tasks();
+    if(withReference)
+    {
+        bmReference_expire(bmTimer_now());
+    }
+}
+
+static void bmCheck_edge(uint8_t button, bool state, bool withReference)
+{
+    if(state == BM_BUTTON_PRESSED)
+    {
+        held |= BUTTON_MATRIX_KEY(button);
+        heldCount++;
+    }
+    else
+    {
+        held &= ~BUTTON_MATRIX_KEY(button);
+        heldCount--;
+    }
+    
+    BUTTON_MATRIX_EventHandler(button, state);
+    BUTTON_MATRIX_Tasks();
+    if(withReference)
+    {
+        bmReference_edge(button, state, bmTimer_now());
+    }
+    edges++;
+}
+
+/* A held button at random, or a random released one */
+static uint8_t bmCheck_pick(bool pressed)
+{
+    uint8_t button;
+    
+    do
+    {
+        button = (uint8_t)(bmCheck_random(BM_CHECK_KEYS) + 1);
+    } while(((held & BUTTON_MATRIX_KEY(button)) != 0) != pressed);
+    
+    return button;
+}
+
+/* From a bounce-free tap to past the long-press time */
+static uint64_t bmCheck_hold(void)
+{
+    switch(bmCheck_random(4))
+    {
+        case 0:
+            return BM_SIM_MS(1 + bmCheck_random(50));
+        case 1:
+            return BM_SIM_MS(50 + bmCheck_random(500));
+        case 2:
+            return BM_SIM_MS(500 + bmCheck_random(CFG_LONG_PRESS_TIME));
+        default:
+            return BM_SIM_MS(CFG_LONG_PRESS_TIME - 50 + bmCheck_random(100));
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n STEPS] [-s SEED]\n"
+            "  Presses and releases random buttons STEPS times (300000 by default) and\n"
+            "  compares the events with the three-slot classifier of the original demo.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t steps = 300000;
+    uint64_t crowded = 0;
+    uint8_t button;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "n:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                steps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                if(seed == 0)
+                {
+                    seed = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    
+    bmSim_reset();
+    BUTTON_MATRIX_init();
+    BUTTON_MATRIX_setEventCallback(bmCheck_libraryEvent);
+    
+    for(uint32_t step = 0; step < steps; step++)
+    {
+        /* Now and then a crowd of four to six buttons, without the reference */
+        if(bmCheck_random(1000) == 0)
+        {
+            while(heldCount != 0)
+            {
+                bmCheck_edge(bmCheck_pick(true), BM_BUTTON_RELEASED, true);
+                bmCheck_wait(bmCheck_hold(), true);
+            }
+            bmCheck_compare();
+            for(uint32_t count = 4 + bmCheck_random(3); heldCount < count; )
+            {
+                bmCheck_edge(bmCheck_pick(false), BM_BUTTON_PRESSED, false);
+                bmCheck_wait(bmCheck_hold(), false);
+            }
+            while(heldCount != 0)
+            {
+                bmCheck_edge(bmCheck_pick(true), BM_BUTTON_RELEASED, false);
+                bmCheck_wait(bmCheck_hold(), false);
+            }
+            libraryLog.count = 0;
+            
+            button = bmCheck_pick(false);
+            bmCheck_edge(button, BM_BUTTON_PRESSED, true);
+            bmCheck_wait(BM_SIM_MS(100), true);
+            bmCheck_edge(button, BM_BUTTON_RELEASED, true);
+            if((libraryLog.count != 1) || (libraryLog.events[0] != BM_CHECK_EVENT(SHORT_PRESS, button, BM_NULL_BTN)))
+            {
+                bmCheck_fail("no SHORT_PRESS after a crowd");
+            }
+            libraryLog.count = 0;
+            referenceLog.count = 0;
+            crowded++;
+            continue;
+        }
+        
+        if((heldCount == 0) || ((heldCount < 3) && (bmCheck_random(2) == 0)))
+        {
+            bmCheck_edge(bmCheck_pick(false), BM_BUTTON_PRESSED, true);
+        }
+        else
+        {
+            bmCheck_edge(bmCheck_pick(true), BM_BUTTON_RELEASED, true);
+        }
+        bmCheck_wait(bmCheck_hold(), true);
+        bmCheck_compare();
+    }
+    
+    printf("edges                %10llu\n", (unsigned long long)edges);
+    for(uint8_t i = 0; i < BM_EVENT_TYPES; i++)
+    {
+        if(eventCount[i] != 0)
+        {
+            printf("%-20s %10llu\n", bmSim_eventNames[i], (unsigned long long)eventCount[i]);
+        }
+    }
+    printf("events compared      %10llu\n", (unsigned long long)compared);
+    printf("crowds of 4 to 6     %10llu\n", (unsigned long long)crowded);
+    printf("failures             %10llu\n", (unsigned long long)failures);
+    
+    return (failures == 0) ? 0 : 1;
+}
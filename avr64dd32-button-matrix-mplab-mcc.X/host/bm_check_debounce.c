@@ -0,0 +1,163 @@
+/**
+ * \file bm_check_debounce.c
+ *
+ * \brief Host check of the debounce engine selected in button_matrix_config.h.
+ *
+ * Feeds random row levels to the simulated matrix before every scan, from
+ * heavy bounce to long calm stretches, and prints a digest of the debounced
+ * state after each scan. Two builds that print the same digest have debounced
+ * every sample alike; bm_check.sh builds the counter and the vertical engine
+ * with the same settings and compares them. The RAM of the debounce state and
+ * the host time per scan are printed too.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bm_sim.h"
+#include "button_matrix_phy.h"
+
+#define BM_CHECK_KEYS           (CFG_ROWS * CFG_COLUMNS)
+#define BM_CHECK_PHASE_SCANS    1000
+
+#if CFG_DEBOUNCE_ALGORITHM == BM_DEBOUNCE_VERTICAL
+#define BM_CHECK_ENGINE         "vertical"
+#define BM_CHECK_DEBOUNCE_RAM   (sizeof(bm_vertical_t) * CFG_COLUMNS)
+#else
+#define BM_CHECK_ENGINE         "counter"
+#define BM_CHECK_DEBOUNCE_RAM   (sizeof(button_t) * CFG_ROWS * CFG_COLUMNS)
+#endif
+
+static uint32_t seed = 1;
+static uint64_t digest = 0xCBF29CE484222325ULL;
+static uint64_t changes;
+
+/* xorshift32, so a seed gives the same samples on every host */
+static uint32_t bmCheck_random(uint32_t range)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return seed % range;
+}
+
+/* Runs count scans; before each one, every key flips with a chance of 1 in flip, none when flip is 0 */
+static void bmCheck_scans(uint32_t count, uint32_t flip)
+{
+    static BUTTON_MATRIX_state_t last;
+    BUTTON_MATRIX_state_t state;
+    
+    for(uint32_t i = 0; i < count; i++)
+    {
+        for(uint8_t key = 1; (flip != 0) && (key <= BM_CHECK_KEYS); key++)
+        {
+            if(bmCheck_random(flip) == 0)
+            {
+                bmSim_setKey(key, !bmSim_getKey(key));
+            }
+        }
+        bmSim_runUntil(bmSim_now() + BM_SIM_US(BM_SCAN_PERIOD_US));
+        
+        /* FNV-1a over the debounced state after every scan */
+        state = BUTTON_MATRIX_getState();
+        for(uint8_t byte = 0; byte < sizeof(state); byte++)
+        {
+            digest = (digest ^ ((state >> (8 * byte)) & 0xFF)) * 0x100000001B3ULL;
+        }
+        if(state != last)
+        {
+            changes++;
+            last = state;
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n SCANS] [-s SEED]\n"
+            "  Scans random row levels SCANS times (2000000 by default), prints a digest\n"
+            "  of the debounced states, then times the scan on a released matrix.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    /* Chance of 1 in n that a key flips before a scan: bounce, slow bounce, typing, rest */
+    static const uint32_t flips[] = {2, 8, 64, 1024};
+    uint32_t scans = 2000000;
+    bm_sim_stats_t noisy;
+    bm_sim_stats_t settled;
+    bm_sim_stats_t quiet;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "n:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                scans = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                if(seed == 0)
+                {
+                    seed = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    
+    bmSim_reset();
+    BUTTON_MATRIX_init();
+    bmSim_setScanTiming(true);
+    
+    for(uint32_t done = 0; done < scans; done += BM_CHECK_PHASE_SCANS)
+    {
+        bmCheck_scans(BM_CHECK_PHASE_SCANS, flips[bmCheck_random(sizeof(flips) / sizeof(flips[0]))]);
+    }
+    bmSim_getStats(&noisy);
+    printf("engine               %s, press %u, release %u, lockout %u scans\n", BM_CHECK_ENGINE,
+           CFG_DEBOUNCE_PRESS_TIME, CFG_DEBOUNCE_RELEASE_TIME, CFG_DEBOUNCE_LOCKOUT);
+    printf("debounce RAM         %u bytes\n", (unsigned)BM_CHECK_DEBOUNCE_RAM);
+    printf("scans                %10llu\n", (unsigned long long)noisy.scans);
+    printf("state changes        %10llu\n", (unsigned long long)changes);
+    printf("state digest         %016llx\n", (unsigned long long)digest);
+    
+    /* Released and settled: the quiet scans only run the debounce of unchanged rows */
+    for(uint8_t key = 1; key <= BM_CHECK_KEYS; key++)
+    {
+        bmSim_setKey(key, false);
+    }
+    bmCheck_scans(BM_CHECK_PHASE_SCANS, 0);
+    bmSim_getStats(&settled);
+    bmCheck_scans(scans / 10, 0);
+    bmSim_getStats(&quiet);
+    
+    /* Each timed call includes the two host clock reads */
+    printf("host time per scan   %10.1f ns random rows, %.1f ns released\n", (double)noisy.scanTime / (double)noisy.scans,
+           (double)(quiet.scanTime - settled.scanTime) / (double)(quiet.scans - settled.scans));
+    
+    return 0;
+}
@@ -0,0 +1,923 @@
+/**
+ * \file bm_check_events.c
+ *
+ * \brief Host check of the event queue and the optional event types, on
+ *        directed key strokes.
+ *
+ * Each case restarts the library on the virtual clock of bm_sim.h, feeds a
+ * few debounced edges with BUTTON_MATRIX_EventHandler, lets the clock run so
+ * the RTC timers expire, and compares the events, the queue and the
+ * statistics with the values the case expects. The cases compiled in depend
+ * on button_matrix_config.h; bm_check.sh builds this program once per
+ * option.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "bm_sim.h"
+
+#define BM_CHECK_LOG_SIZE       64
+
+static BUTTON_MATRIX_eventRecord_t eventLog[BM_CHECK_LOG_SIZE];
+static uint8_t logCount;
+static unsigned cases;
+static unsigned failures;
+
+/* Record callback: keeps the events of the running case */
+static void bmCheck_record(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    if(logCount < BM_CHECK_LOG_SIZE)
+    {
+        eventLog[logCount] = *record;
+    }
+    if(logCount < UINT8_MAX)
+    {
+        logCount++;
+    }
+}
+
+/* Restarts the virtual clock and the library for the next case */
+static void bmCheck_begin(void)
+{
+    bmSim_reset();
+    BUTTON_MATRIX_init();
+    BUTTON_MATRIX_setRecordCallback(bmCheck_record);
+    logCount = 0;
+}
+
+/* Prints the result of a case, and the events it logged when it failed */
+static void bmCheck_end(const char *name, bool pass)
+{
+    printf("%-52s %s\n", name, pass ? "pass" : "FAIL");
+    if(!pass)
+    {
+        for(uint8_t i = 0; (i < logCount) && (i < BM_CHECK_LOG_SIZE); i++)
+        {
+            printf("    %-20s btn1 %2u btn2 %2u keys 0x%08lx tick %8lu duration %5u count %u\n",
+                   bmSim_eventNames[eventLog[i].event], eventLog[i].btn1, eventLog[i].btn2, (unsigned long)eventLog[i].keys,
+                   (unsigned long)eventLog[i].timestamp, eventLog[i].duration, eventLog[i].count);
+        }
+        failures++;
+    }
+    cases++;
+}
+
+/* Feeds one debounced edge, then runs what the main loop would */
+static void bmCheck_edge(uint8_t button, bool state)
+{
+    BUTTON_MATRIX_EventHandler(button, state);
+    BUTTON_MATRIX_Tasks();
+}
+
+/* Advances the virtual clock by ms, running what the main loop would every ms */
+static void bmCheck_wait(uint32_t ms)
+{
+    for(uint32_t i = 0; i < ms; i++)
+    {
+        bmSim_runUntil(bmSim_now() + BM_SIM_MS(1));
+        BUTTON_MATRIX_Tasks();
+    }
+}
+
+/* Presses the button for hold ms, releases it and waits gap ms */
+static void bmCheck_tap(uint8_t button, uint32_t hold, uint32_t gap)
+{
+    bmCheck_edge(button, BM_BUTTON_PRESSED);
+    bmCheck_wait(hold);
+    bmCheck_edge(button, BM_BUTTON_RELEASED);
+    bmCheck_wait(gap);
+}
+
+/* True when the record has the event and button */
+static bool bmCheck_is(const BUTTON_MATRIX_eventRecord_t *record, uint8_t event, uint8_t btn1)
+{
+    return (record->event == event) && (record->btn1 == btn1);
+}
+
+/* The duration of the record is ms, or 1 ms less after the conversion from ticks */
+static bool bmCheck_duration(const BUTTON_MATRIX_eventRecord_t *record, uint16_t ms)
+{
+    return (record->duration == ms) || (record->duration + 1 == ms);
+}
+
+#if !CFG_RAW_EVENTS && !CFG_MULTI_TAP
+/* The queue cases count one SHORT_PRESS per tap, so they only run without the extra event types */
+
+/* The queue hands the events out oldest first, and counts how many it held at most */
+static void bmCheck_queueOrder(void)
+{
+    BUTTON_MATRIX_eventRecord_t record;
+    bool pass = true;
+    
+    bmCheck_begin();
+    for(uint8_t button = 1; button <= 5; button++)
+    {
+        bmCheck_tap(button, 50, 400);
+    }
+    
+    pass = pass && BUTTON_MATRIX_poll();
+    for(uint8_t button = 1; button <= 5; button++)
+    {
+        pass = pass && BUTTON_MATRIX_getEvent(&record) && bmCheck_is(&record, SHORT_PRESS, button) && bmCheck_duration(&record, 50);
+    }
+    pass = pass && !BUTTON_MATRIX_poll() && !BUTTON_MATRIX_getEvent(&record);
+    pass = pass && (BUTTON_MATRIX_getDroppedEvents() == 0) && (BUTTON_MATRIX_getQueueHighWater() == 5);
+    
+    bmCheck_end("queue: events in order, high-water mark 5", pass);
+}
+
+/* A full queue keeps the oldest events and counts the ones it could not store */
+static void bmCheck_queueOverflow(void)
+{
+    BUTTON_MATRIX_eventRecord_t buffer[CFG_EVENT_QUEUE_SIZE + 8];
+    uint8_t count;
+    bool pass = true;
+    
+    bmCheck_begin();
+    for(uint8_t i = 0; i < CFG_EVENT_QUEUE_SIZE + 4; i++)
+    {
+        bmCheck_tap((uint8_t)((i % BM_KEY_CODES) + 1), 50, 400);
+    }
+    
+    count = BUTTON_MATRIX_readEvents(buffer, CFG_EVENT_QUEUE_SIZE + 8);
+    pass = pass && (count == CFG_EVENT_QUEUE_SIZE);
+    for(uint8_t i = 0; pass && (i < count); i++)
+    {
+        pass = bmCheck_is(&buffer[i], SHORT_PRESS, (uint8_t)((i % BM_KEY_CODES) + 1));
+    }
+    pass = pass && (BUTTON_MATRIX_getDroppedEvents() == 4) && (BUTTON_MATRIX_getQueueHighWater() == CFG_EVENT_QUEUE_SIZE);
+    
+    /* Once drained, the queue takes events again; the counters keep their values */
+    bmCheck_tap(1, 50, 400);
+    pass = pass && (BUTTON_MATRIX_readEvents(buffer, CFG_EVENT_QUEUE_SIZE + 8) == 1) && bmCheck_is(&buffer[0], SHORT_PRESS, 1);
+    pass = pass && (BUTTON_MATRIX_getDroppedEvents() == 4) && (BUTTON_MATRIX_getQueueHighWater() == CFG_EVENT_QUEUE_SIZE);
+    
+    bmCheck_end("queue: overflow keeps the oldest, counts 4 drops", pass);
+}
+
+/* readEvents copies at most max events and leaves the rest queued */
+static void bmCheck_queueRead(void)
+{
+    BUTTON_MATRIX_eventRecord_t buffer[4];
+    bool pass = true;
+    
+    bmCheck_begin();
+    for(uint8_t button = 1; button <= 6; button++)
+    {
+        bmCheck_tap(button, 50, 400);
+    }
+    
+    pass = pass && (BUTTON_MATRIX_readEvents(buffer, 4) == 4) && bmCheck_is(&buffer[0], SHORT_PRESS, 1) &&
+           bmCheck_is(&buffer[3], SHORT_PRESS, 4);
+    pass = pass && (BUTTON_MATRIX_readEvents(buffer, 4) == 2) && bmCheck_is(&buffer[0], SHORT_PRESS, 5) &&
+           bmCheck_is(&buffer[1], SHORT_PRESS, 6);
+    pass = pass && (BUTTON_MATRIX_readEvents(buffer, 4) == 0);
+    
+    bmCheck_end("queue: readEvents stops at max", pass);
+}
+
+/* The drop counter stops at 65535 instead of wrapping */
+static void bmCheck_queueDropLimit(void)
+{
+    BUTTON_MATRIX_eventRecord_t record;
+    bool pass;
+    
+    bmCheck_begin();
+    for(uint32_t i = 0; i < CFG_EVENT_QUEUE_SIZE + 70000UL; i++)
+    {
+        bmCheck_edge(1, BM_BUTTON_PRESSED);
+        bmCheck_edge(1, BM_BUTTON_RELEASED);
+    }
+    
+    pass = (BUTTON_MATRIX_getDroppedEvents() == UINT16_MAX) && BUTTON_MATRIX_getEvent(&record) && bmCheck_is(&record, SHORT_PRESS, 1);
+    
+    bmCheck_end("queue: drop counter stops at 65535", pass);
+}
+
+#if CFG_DEFERRED_DISPATCH
+/* Edges that find the deferred records full are lost, and counted with the dropped events */
+static void bmCheck_deferredOverflow(void)
+{
+    BUTTON_MATRIX_eventRecord_t buffer[CFG_DEFERRED_QUEUE_SIZE];
+    uint8_t taps = CFG_DEFERRED_QUEUE_SIZE / 2;
+    bool pass = true;
+    
+    bmCheck_begin();
+    for(uint8_t i = 0; i < taps + 2; i++)
+    {
+        BUTTON_MATRIX_EventHandler((uint8_t)(i + 1), BM_BUTTON_PRESSED);
+        bmSim_runUntil(bmSim_now() + BM_SIM_MS(50));
+        BUTTON_MATRIX_EventHandler((uint8_t)(i + 1), BM_BUTTON_RELEASED);
+    }
+    BUTTON_MATRIX_Tasks();
+    
+    pass = pass && (BUTTON_MATRIX_readEvents(buffer, CFG_DEFERRED_QUEUE_SIZE) == taps);
+    for(uint8_t i = 0; pass && (i < taps); i++)
+    {
+        pass = bmCheck_is(&buffer[i], SHORT_PRESS, (uint8_t)(i + 1));
+    }
+    pass = pass && (BUTTON_MATRIX_getDroppedEvents() == 4);
+    
+    bmCheck_end("deferred: overflow of the records counts 4 drops", pass);
+}
+#endif
+#endif
+
+#if CFG_RAW_EVENTS
+/* A short press is framed by PRESS and RELEASE, stamped at the edges */
+static void bmCheck_rawShortPress(void)
+{
+    uint32_t pressTime;
+    uint32_t releaseTime;
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_wait(10);
+    pressTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(3, BM_BUTTON_PRESSED);
+    bmCheck_wait(120);
+    releaseTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(3, BM_BUTTON_RELEASED);
+    bmCheck_wait(400);
+    
+    pass = (logCount == 3);
+    pass = pass && bmCheck_is(&eventLog[0], PRESS, 3) && (eventLog[0].keys == BUTTON_MATRIX_KEY(3)) &&
+           (eventLog[0].timestamp == pressTime) && (eventLog[0].duration == 0);
+    pass = pass && bmCheck_is(&eventLog[1], RELEASE, 3) && (eventLog[1].keys == 0) &&
+           (eventLog[1].timestamp == releaseTime) && bmCheck_duration(&eventLog[1], 120);
+    pass = pass && bmCheck_is(&eventLog[2], SHORT_PRESS, 3);
+    
+    bmCheck_end("raw: PRESS, RELEASE, SHORT_PRESS of a tap", pass);
+}
+
+/* Every edge of a chord is reported with the keys held after it */
+static void bmCheck_rawChord(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_edge(1, BM_BUTTON_PRESSED);
+    bmCheck_wait(20);
+    bmCheck_edge(2, BM_BUTTON_PRESSED);
+    bmCheck_wait(100);
+    bmCheck_edge(2, BM_BUTTON_RELEASED);
+    bmCheck_wait(20);
+    bmCheck_edge(1, BM_BUTTON_RELEASED);
+    bmCheck_wait(400);
+    
+    pass = (logCount == 5);
+    pass = pass && bmCheck_is(&eventLog[0], PRESS, 1) && (eventLog[0].keys == BUTTON_MATRIX_KEY(1));
+    pass = pass && bmCheck_is(&eventLog[1], PRESS, 2) && (eventLog[1].keys == (BUTTON_MATRIX_KEY(1) | BUTTON_MATRIX_KEY(2)));
+    pass = pass && bmCheck_is(&eventLog[2], RELEASE, 2) && (eventLog[2].keys == BUTTON_MATRIX_KEY(1)) && bmCheck_duration(&eventLog[2], 100);
+    pass = pass && bmCheck_is(&eventLog[3], MULTIPLE_SHORT_PRESS, 1) && (eventLog[3].btn2 == 2);
+    pass = pass && bmCheck_is(&eventLog[4], RELEASE, 1) && (eventLog[4].keys == 0) && bmCheck_duration(&eventLog[4], 140);
+    
+    bmCheck_end("raw: chord edges with the held keys", pass);
+}
+
+/* An edge that does not change the held keys is not reported again */
+static void bmCheck_rawRepeatedEdge(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_edge(4, BM_BUTTON_PRESSED);
+    bmCheck_edge(4, BM_BUTTON_PRESSED);
+    bmCheck_wait(80);
+    bmCheck_edge(4, BM_BUTTON_RELEASED);
+    bmCheck_edge(4, BM_BUTTON_RELEASED);
+    bmCheck_wait(400);
+    
+    pass = (logCount == 3) && bmCheck_is(&eventLog[0], PRESS, 4) && bmCheck_is(&eventLog[1], RELEASE, 4) &&
+           bmCheck_is(&eventLog[2], SHORT_PRESS, 4);
+    
+    bmCheck_end("raw: repeated edges reported once", pass);
+}
+
+/* A long press comes between PRESS and RELEASE, and no SHORT_PRESS follows */
+static void bmCheck_rawLongPress(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_tap(5, CFG_LONG_PRESS_TIME + 500, 400);
+    
+    pass = (logCount == 3) && bmCheck_is(&eventLog[0], PRESS, 5) && bmCheck_is(&eventLog[1], LONG_PRESS, 5) &&
+           bmCheck_is(&eventLog[2], RELEASE, 5) && bmCheck_duration(&eventLog[2], CFG_LONG_PRESS_TIME + 500);
+    
+    bmCheck_end("raw: LONG_PRESS between PRESS and RELEASE", pass);
+}
+#endif
+
+#if CFG_AUTO_REPEAT
+/*
+ * Checks the REPEAT events of button logged from index on: the first one CFG_REPEAT_DELAY after pressTime,
+ * then at intervals that shrink by CFG_REPEAT_ACCELERATION down to
+ * CFG_REPEAT_MIN_INTERVAL, as long as they fall before endTime, and none after
+ */
+static bool bmCheck_repeats(uint8_t *index, uint8_t button, uint32_t pressTime, uint32_t endTime)
+{
+    uint32_t deadline = pressTime + BM_TIMER_MS(CFG_REPEAT_DELAY);
+    uint16_t interval = CFG_REPEAT_INTERVAL;
+    uint8_t count = 0;
+    
+    while((int32_t)(deadline - endTime) < 0)
+    {
+        if((*index >= logCount) || !bmCheck_is(&eventLog[*index], REPEAT, button) || (eventLog[*index].timestamp != deadline) ||
+           (eventLog[*index].duration != bmTimer_toMs(deadline - pressTime)))
+        {
+            return false;
+        }
+        (*index)++;
+        count++;
+        
+        deadline += BM_TIMER_MS(interval);
+        interval = (interval > CFG_REPEAT_MIN_INTERVAL + CFG_REPEAT_ACCELERATION) ? (interval - CFG_REPEAT_ACCELERATION) : CFG_REPEAT_MIN_INTERVAL;
+    }
+    
+    return (count != 0) && ((*index >= logCount) || !bmCheck_is(&eventLog[*index], REPEAT, button));
+}
+
+/* A held button repeats at a shrinking interval until it is released, then reports its short press */
+static void bmCheck_repeatSequence(void)
+{
+    uint32_t pressTime;
+    uint32_t releaseTime;
+    uint8_t index = 0;
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_wait(10);
+    pressTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(5, BM_BUTTON_PRESSED);
+    bmCheck_wait(CFG_LONG_PRESS_TIME - 100);
+    releaseTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(5, BM_BUTTON_RELEASED);
+    bmCheck_wait(1000);
+    
+    pass = bmCheck_repeats(&index, 5, pressTime, releaseTime);
+    pass = pass && (index + 1 == logCount) && bmCheck_is(&eventLog[index], SHORT_PRESS, 5);
+    
+    bmCheck_end("repeat: delay, shrinking interval, stop on release", pass);
+}
+
+/* The repeat goes on through the long press */
+static void bmCheck_repeatLongPress(void)
+{
+    uint32_t pressTime;
+    uint32_t releaseTime;
+    uint8_t index = 0;
+    uint8_t longPress = 0;
+    bool pass;
+    
+    bmCheck_begin();
+    pressTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(7, BM_BUTTON_PRESSED);
+    bmCheck_wait(CFG_LONG_PRESS_TIME + 500);
+    releaseTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(7, BM_BUTTON_RELEASED);
+    bmCheck_wait(1000);
+    
+    /* Take the LONG_PRESS out of the log, the REPEAT events around it must be one sequence */
+    while((longPress < logCount) && (eventLog[longPress].event != LONG_PRESS))
+    {
+        longPress++;
+    }
+    pass = (longPress < logCount) && bmCheck_is(&eventLog[longPress], LONG_PRESS, 7) && (longPress != 0) &&
+           (longPress + 1 < logCount) && (eventLog[longPress + 1].event == REPEAT);
+    if(pass)
+    {
+        for(uint8_t i = longPress; i + 1 < logCount; i++)
+        {
+            eventLog[i] = eventLog[i + 1];
+        }
+        logCount--;
+    }
+    pass = pass && bmCheck_repeats(&index, 7, pressTime, releaseTime) && (index == logCount);
+    
+    bmCheck_end("repeat: goes on through LONG_PRESS", pass);
+}
+
+/* Only the most recently pressed button repeats, and its release ends the repeat */
+static void bmCheck_repeatNewestKey(void)
+{
+    uint32_t firstTime;
+    uint32_t secondTime;
+    uint32_t releaseTime;
+    uint8_t index = 0;
+    bool pass;
+    
+    bmCheck_begin();
+    firstTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(5, BM_BUTTON_PRESSED);
+    bmCheck_wait(CFG_REPEAT_DELAY + 150);
+    secondTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(6, BM_BUTTON_PRESSED);
+    bmCheck_wait(CFG_REPEAT_DELAY + 400);
+    releaseTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(6, BM_BUTTON_RELEASED);
+    bmCheck_wait(1000);
+    bmCheck_edge(5, BM_BUTTON_RELEASED);
+    bmCheck_wait(1000);
+    
+    pass = bmCheck_repeats(&index, 5, firstTime, secondTime);
+    pass = pass && bmCheck_repeats(&index, 6, secondTime, releaseTime);
+    pass = pass && (index + 1 == logCount) && bmCheck_is(&eventLog[index], MULTIPLE_SHORT_PRESS, 5);
+    
+    bmCheck_end("repeat: newest key only, held key does not resume", pass);
+}
+
+/* Releasing an older button leaves the repeat of the newest one running */
+static void bmCheck_repeatOlderRelease(void)
+{
+    uint32_t secondTime;
+    uint32_t releaseTime;
+    uint8_t index = 0;
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_edge(5, BM_BUTTON_PRESSED);
+    bmCheck_wait(100);
+    secondTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(6, BM_BUTTON_PRESSED);
+    bmCheck_wait(100);
+    bmCheck_edge(5, BM_BUTTON_RELEASED);
+    bmCheck_wait(1200);
+    releaseTime = BUTTON_MATRIX_getTime();
+    bmCheck_edge(6, BM_BUTTON_RELEASED);
+    bmCheck_wait(1000);
+    
+    pass = (logCount != 0) && bmCheck_is(&eventLog[0], MULTIPLE_SHORT_PRESS, 5);
+    index = 1;
+    pass = pass && bmCheck_repeats(&index, 6, secondTime, releaseTime) && (index == logCount);
+    
+    bmCheck_end("repeat: survives the release of an older key", pass);
+}
+#endif
+
+#if CFG_MULTI_TAP
+#if (CFG_TAP_DELAY_KEYS) != 0x0002
+#error "The tap cases expect CFG_TAP_DELAY_KEYS 0x0002, bm_check.sh sets it"
+#endif
+
+/* True when the record is a tap event of button with count taps */
+static bool bmCheck_isTap(const BUTTON_MATRIX_eventRecord_t *record, uint8_t event, uint8_t button, uint8_t count)
+{
+    return bmCheck_is(record, event, button) && (record->count == count);
+}
+
+/* A second tap that starts just inside the window is a DOUBLE_TAP, just outside it a new sequence */
+static void bmCheck_tapWindow(void)
+{
+    uint32_t firstPress;
+    uint32_t secondRelease;
+    bool pass;
+    
+    bmCheck_begin();
+    firstPress = BUTTON_MATRIX_getTime();
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW - 1);
+    bmCheck_edge(1, BM_BUTTON_PRESSED);
+    bmCheck_wait(50);
+    secondRelease = BUTTON_MATRIX_getTime();
+    bmCheck_edge(1, BM_BUTTON_RELEASED);
+    bmCheck_wait(CFG_TAP_WINDOW + 100);
+    
+    pass = (logCount == 3) && bmCheck_isTap(&eventLog[0], SHORT_PRESS, 1, 1) && bmCheck_isTap(&eventLog[1], SHORT_PRESS, 1, 2);
+    pass = pass && bmCheck_isTap(&eventLog[2], DOUBLE_TAP, 1, 2) && (eventLog[2].timestamp == secondRelease) &&
+           (eventLog[2].duration == bmTimer_toMs(secondRelease - firstPress));
+    bmCheck_end("tap: DOUBLE_TAP 1 ms inside CFG_TAP_WINDOW", pass);
+    
+    bmCheck_begin();
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW + 1);
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW + 100);
+    
+    pass = (logCount == 2) && bmCheck_isTap(&eventLog[0], SHORT_PRESS, 1, 1) && bmCheck_isTap(&eventLog[1], SHORT_PRESS, 1, 1);
+    bmCheck_end("tap: new sequence 1 ms after CFG_TAP_WINDOW", pass);
+}
+
+/* The third and later taps report N_TAP with the number of taps */
+static void bmCheck_tapCount(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        bmCheck_tap(1, 50, CFG_TAP_WINDOW / 2);
+    }
+    bmCheck_wait(CFG_TAP_WINDOW);
+    
+    pass = (logCount == 7) && bmCheck_isTap(&eventLog[0], SHORT_PRESS, 1, 1) && bmCheck_isTap(&eventLog[1], SHORT_PRESS, 1, 2) &&
+           bmCheck_isTap(&eventLog[2], DOUBLE_TAP, 1, 2) && bmCheck_isTap(&eventLog[3], SHORT_PRESS, 1, 3) &&
+           bmCheck_isTap(&eventLog[4], N_TAP, 1, 3) && bmCheck_isTap(&eventLog[5], SHORT_PRESS, 1, 4) &&
+           bmCheck_isTap(&eventLog[6], N_TAP, 1, 4);
+    
+    bmCheck_end("tap: N_TAP counts 3 and 4 taps", pass);
+}
+
+/* A tap of another button, or a long press, ends the sequence */
+static void bmCheck_tapInterrupted(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW / 2);
+    bmCheck_tap(3, 50, CFG_TAP_WINDOW / 2);
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW + 100);
+    
+    pass = (logCount == 3) && bmCheck_isTap(&eventLog[0], SHORT_PRESS, 1, 1) && bmCheck_duration(&eventLog[0], 50) &&
+           bmCheck_isTap(&eventLog[1], SHORT_PRESS, 3, 1) &&
+           bmCheck_isTap(&eventLog[2], SHORT_PRESS, 1, 1);
+    bmCheck_end("tap: another button starts a new sequence", pass);
+    
+    bmCheck_begin();
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW / 2);
+    bmCheck_tap(1, CFG_LONG_PRESS_TIME + 100, CFG_TAP_WINDOW / 2);
+    bmCheck_tap(1, 50, CFG_TAP_WINDOW + 100);
+    
+    pass = (logCount == 3) && bmCheck_isTap(&eventLog[0], SHORT_PRESS, 1, 1) && bmCheck_is(&eventLog[1], LONG_PRESS, 1) &&
+           bmCheck_isTap(&eventLog[2], SHORT_PRESS, 1, 1);
+    bmCheck_end("tap: LONG_PRESS ends the sequence", pass);
+}
+
+/* A button of CFG_TAP_DELAY_KEYS reports its sequence once, when the window after the last release ends */
+static void bmCheck_tapDelayed(void)
+{
+    static const BUTTON_MATRIX_event_t events[] = {SHORT_PRESS, DOUBLE_TAP, N_TAP};
+    uint32_t firstPress;
+    uint32_t lastRelease;
+    bool pass;
+    
+    for(uint8_t taps = 1; taps <= 3; taps++)
+    {
+        bmCheck_begin();
+        firstPress = BUTTON_MATRIX_getTime();
+        for(uint8_t i = 1; i < taps; i++)
+        {
+            bmCheck_tap(2, 50, CFG_TAP_WINDOW / 2);
+        }
+        bmCheck_edge(2, BM_BUTTON_PRESSED);
+        bmCheck_wait(50);
+        lastRelease = BUTTON_MATRIX_getTime();
+        bmCheck_edge(2, BM_BUTTON_RELEASED);
+        bmCheck_wait(CFG_TAP_WINDOW - 1);
+        pass = (logCount == 0);
+        bmCheck_wait(2);
+        
+        pass = pass && (logCount == 1) && bmCheck_isTap(&eventLog[0], events[taps - 1], 2, taps) &&
+               (eventLog[0].timestamp == lastRelease) && (eventLog[0].duration == bmTimer_toMs(lastRelease - firstPress));
+        bmCheck_end((taps == 1) ? "tap: delayed key, SHORT_PRESS after the window" :
+                    (taps == 2) ? "tap: delayed key, DOUBLE_TAP after the window" : "tap: delayed key, N_TAP after the window", pass);
+    }
+    
+    /* Pressing another button reports the sequence at once */
+    bmCheck_begin();
+    bmCheck_tap(2, 50, CFG_TAP_WINDOW / 2);
+    bmCheck_tap(2, 50, CFG_TAP_WINDOW / 2);
+    bmCheck_edge(1, BM_BUTTON_PRESSED);
+    pass = (logCount == 1) && bmCheck_isTap(&eventLog[0], DOUBLE_TAP, 2, 2);
+    bmCheck_wait(50);
+    bmCheck_edge(1, BM_BUTTON_RELEASED);
+    bmCheck_wait(CFG_TAP_WINDOW + 100);
+    
+    pass = pass && (logCount == 2) && bmCheck_isTap(&eventLog[1], SHORT_PRESS, 1, 1);
+    bmCheck_end("tap: delayed key, ended by another press", pass);
+}
+#endif
+
+#if CFG_SUBSCRIBERS
+#if CFG_SUBSCRIBERS != 4
+#error "The subscriber cases expect CFG_SUBSCRIBERS 4, bm_check.sh sets it"
+#endif
+
+#define BM_CHECK_SUBSCRIBER_LOG 8
+#define BM_CHECK_SUBSCRIBERS    4
+
+/* Events one subscriber callback received, as event << 8 | btn1 */
+typedef struct {
+    uint16_t events[BM_CHECK_SUBSCRIBER_LOG];
+    uint8_t count;
+} bm_check_subscriber_t;
+
+static bm_check_subscriber_t subscriberLog[BM_CHECK_SUBSCRIBERS];
+static uint8_t selfHandle;
+
+static void bmCheck_subscriberRecord(uint8_t n, const BUTTON_MATRIX_eventRecord_t *record)
+{
+    if(subscriberLog[n].count < BM_CHECK_SUBSCRIBER_LOG)
+    {
+        subscriberLog[n].events[subscriberLog[n].count] = (uint16_t)((record->event << 8) | record->btn1);
+    }
+    subscriberLog[n].count++;
+}
+
+static void bmCheck_subscriber0(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    bmCheck_subscriberRecord(0, record);
+}
+
+static void bmCheck_subscriber1(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    bmCheck_subscriberRecord(1, record);
+}
+
+static void bmCheck_subscriber2(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    bmCheck_subscriberRecord(2, record);
+}
+
+/* Subscribes subscriber 2 to everything on its first event, and unsubscribes itself */
+static void bmCheck_subscriberChanger(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    bmCheck_subscriberRecord(3, record);
+    if(subscriberLog[3].count == 1)
+    {
+        BUTTON_MATRIX_subscribe(bmCheck_subscriber2, BM_EVENT_MASK_ALL, BM_KEYS_ANY);
+        BUTTON_MATRIX_unsubscribe(selfHandle);
+    }
+}
+
+/* True when subscriber n received exactly the count events, each given as event, btn1 */
+static bool bmCheck_received(uint8_t n, uint8_t count, ...)
+{
+    va_list args;
+    bool pass = (subscriberLog[n].count == count);
+    
+    va_start(args, count);
+    for(uint8_t i = 0; pass && (i < count); i++)
+    {
+        uint8_t event = (uint8_t)va_arg(args, int);
+        uint8_t btn1 = (uint8_t)va_arg(args, int);
+        
+        pass = (subscriberLog[n].events[i] == (uint16_t)((event << 8) | btn1));
+    }
+    va_end(args);
+    
+    return pass;
+}
+
+/* Restarts the library with every subscriber entry free and no subscriber event logged */
+static void bmCheck_beginSubscribers(void)
+{
+    bmCheck_begin();
+    for(uint8_t handle = 0; handle < CFG_SUBSCRIBERS; handle++)
+    {
+        BUTTON_MATRIX_unsubscribe(handle);
+    }
+    memset(subscriberLog, 0, sizeof(subscriberLog));
+}
+
+/* A chord of two buttons, released after 100 ms */
+static void bmCheck_chord(uint8_t first, uint8_t second)
+{
+    bmCheck_edge(first, BM_BUTTON_PRESSED);
+    bmCheck_wait(20);
+    bmCheck_edge(second, BM_BUTTON_PRESSED);
+    bmCheck_wait(100);
+    bmCheck_edge(second, BM_BUTTON_RELEASED);
+    bmCheck_edge(first, BM_BUTTON_RELEASED);
+    bmCheck_wait(400);
+}
+
+/* Each subscriber only receives its event types, and only those that involve one of its keys */
+static void bmCheck_subscriberMasks(void)
+{
+    bool pass;
+    
+    bmCheck_beginSubscribers();
+    BUTTON_MATRIX_subscribe(bmCheck_subscriber0, BM_EVENT_MASK(SHORT_PRESS), BM_KEYS_ANY);
+    BUTTON_MATRIX_subscribe(bmCheck_subscriber1, BM_EVENT_MASK_ALL, BUTTON_MATRIX_KEY(3) | BUTTON_MATRIX_KEY(4));
+    BUTTON_MATRIX_subscribe(bmCheck_subscriber2, BM_EVENT_MASK(LONG_PRESS) | BM_EVENT_MASK(MULTIPLE_SHORT_PRESS), BUTTON_MATRIX_KEY(1));
+    
+    bmCheck_tap(1, 50, 400);
+    bmCheck_tap(3, 50, 400);
+    bmCheck_tap(1, CFG_LONG_PRESS_TIME + 100, 400);
+    bmCheck_chord(5, 3);
+    bmCheck_chord(2, 1);
+    
+    pass = (logCount == 5);
+    pass = pass && bmCheck_received(0, 2, SHORT_PRESS, 1, SHORT_PRESS, 3);
+    pass = pass && bmCheck_received(1, 2, SHORT_PRESS, 3, MULTIPLE_SHORT_PRESS, 5);
+    pass = pass && bmCheck_received(2, 2, LONG_PRESS, 1, MULTIPLE_SHORT_PRESS, 2);
+    
+    bmCheck_end("subscribers: event and key masks", pass);
+}
+
+/* The table takes CFG_SUBSCRIBERS callbacks, and refuses more and NULL */
+static void bmCheck_subscriberTable(void)
+{
+    bool pass = true;
+    
+    bmCheck_beginSubscribers();
+    for(uint8_t handle = 0; handle < CFG_SUBSCRIBERS; handle++)
+    {
+        pass = pass && (BUTTON_MATRIX_subscribe(bmCheck_subscriber0, BM_EVENT_MASK_ALL, BM_KEYS_ANY) == handle);
+    }
+    pass = pass && (BUTTON_MATRIX_subscribe(bmCheck_subscriber1, BM_EVENT_MASK_ALL, BM_KEYS_ANY) == BM_SUBSCRIBER_NONE);
+    
+    BUTTON_MATRIX_unsubscribe(2);
+    BUTTON_MATRIX_unsubscribe(BM_SUBSCRIBER_NONE);
+    pass = pass && (BUTTON_MATRIX_subscribe(NULL, BM_EVENT_MASK_ALL, BM_KEYS_ANY) == BM_SUBSCRIBER_NONE);
+    pass = pass && (BUTTON_MATRIX_subscribe(bmCheck_subscriber1, BM_EVENT_MASK_ALL, BM_KEYS_ANY) == 2);
+    
+    bmCheck_tap(1, 50, 400);
+    pass = pass && bmCheck_received(0, 3, SHORT_PRESS, 1, SHORT_PRESS, 1, SHORT_PRESS, 1) && bmCheck_received(1, 1, SHORT_PRESS, 1);
+    
+    bmCheck_end("subscribers: full table, NULL, freed entry reused", pass);
+}
+
+/* A callback may subscribe and unsubscribe; the change applies from the next event on */
+static void bmCheck_subscriberChange(void)
+{
+    bool pass;
+    
+    bmCheck_beginSubscribers();
+    BUTTON_MATRIX_subscribe(bmCheck_subscriber0, BM_EVENT_MASK_ALL, BM_KEYS_ANY);
+    selfHandle = BUTTON_MATRIX_subscribe(bmCheck_subscriberChanger, BM_EVENT_MASK_ALL, BM_KEYS_ANY);
+    
+    bmCheck_tap(1, 50, 400);
+    bmCheck_tap(2, 50, 400);
+    
+    pass = bmCheck_received(0, 2, SHORT_PRESS, 1, SHORT_PRESS, 2);
+    pass = pass && bmCheck_received(3, 1, SHORT_PRESS, 1);
+    pass = pass && bmCheck_received(2, 1, SHORT_PRESS, 2);
+    
+    bmCheck_end("subscribers: changed from a callback", pass);
+}
+#endif
+
+#if CFG_LATENCY_HISTOGRAM
+/* Log2 bin of a latency in ms, as documented for BUTTON_MATRIX_getLatencyHistogram */
+static uint8_t bmCheck_latencyBin(uint16_t ms)
+{
+    uint8_t bin = 0;
+    
+    while((ms >> bin) != 0)
+    {
+        bin++;
+    }
+    
+    return (bin < BM_LATENCY_BINS) ? bin : (BM_LATENCY_BINS - 1);
+}
+
+/* True when the histogram of event has count in bin and nothing in the other bins */
+static bool bmCheck_histogram(uint8_t event, uint8_t bin, uint16_t count)
+{
+    uint16_t bins[BM_LATENCY_BINS];
+    bool pass = BUTTON_MATRIX_getLatencyHistogram(event, bins);
+    
+    for(uint8_t i = 0; pass && (i < BM_LATENCY_BINS); i++)
+    {
+        pass = (bins[i] == ((i == bin) ? count : 0));
+    }
+    
+    return pass;
+}
+
+/* Edge events count from their own edge, timer events from the last edge of btn1 */
+static void bmCheck_histogramBins(void)
+{
+    bool pass = true;
+    
+    bmCheck_begin();
+    BUTTON_MATRIX_resetLatencyHistogram();
+    bmCheck_tap(1, 50, 400);
+    bmCheck_tap(2, CFG_LONG_PRESS_TIME + 100, 400);
+    bmCheck_edge(3, BM_BUTTON_PRESSED);
+    bmCheck_wait(3000);
+    bmCheck_edge(4, BM_BUTTON_PRESSED);
+    bmCheck_wait(CFG_LONG_PRESS_TIME + 100);
+    bmCheck_edge(4, BM_BUTTON_RELEASED);
+    bmCheck_edge(3, BM_BUTTON_RELEASED);
+    bmCheck_wait(400);
+    
+    pass = pass && bmCheck_histogram(SHORT_PRESS, 0, 1);
+    pass = pass && bmCheck_histogram(LONG_PRESS, bmCheck_latencyBin(CFG_LONG_PRESS_TIME), 2);
+    pass = pass && bmCheck_histogram(MULTIPLE_LONG_PRESS, BM_LATENCY_BINS - 1, 1);
+    for(uint8_t event = 0; event < BM_EVENT_TYPES; event++)
+    {
+        if((event != SHORT_PRESS) && (event != LONG_PRESS) && (event != MULTIPLE_LONG_PRESS))
+        {
+            pass = pass && bmCheck_histogram(event, 0, 0);
+        }
+    }
+    
+    bmCheck_end("histogram: edge, long press and 5 s chord bins", pass);
+}
+
+/* A press through the scan counts from the raw edge, not from the debounced one */
+static void bmCheck_histogramScan(void)
+{
+    uint32_t callbackTime;
+    bool pass;
+    
+    bmCheck_begin();
+    BUTTON_MATRIX_resetLatencyHistogram();
+    bmSim_setKey(6, true);
+    bmSim_runUntil(bmSim_now() + BM_SIM_MS(200));
+    bmSim_setKey(6, false);
+    for(uint32_t i = 0; (i < 100000UL) && (logCount == 0); i++)
+    {
+        bmSim_runUntil(bmSim_now() + BM_SIM_US(10));
+        BUTTON_MATRIX_Tasks();
+    }
+    callbackTime = BUTTON_MATRIX_getTime();
+    
+    pass = (logCount == 1) && bmCheck_is(&eventLog[0], SHORT_PRESS, 6) && (callbackTime - eventLog[0].timestamp >= BM_TIMER_MS(1)) &&
+           bmCheck_histogram(SHORT_PRESS, bmCheck_latencyBin(bmTimer_toMs(callbackTime - eventLog[0].timestamp)), 1);
+    
+    bmCheck_end("histogram: scanned key counts from the raw edge", pass);
+}
+
+/* A reset reads empty at once and takes effect with the next event; the bins stop at 65535 */
+static void bmCheck_histogramReset(void)
+{
+    bool pass;
+    
+    bmCheck_begin();
+    BUTTON_MATRIX_resetLatencyHistogram();
+    bmCheck_tap(2, CFG_LONG_PRESS_TIME + 100, 400);
+    bmCheck_tap(1, 50, 400);
+    pass = bmCheck_histogram(LONG_PRESS, bmCheck_latencyBin(CFG_LONG_PRESS_TIME), 1) && bmCheck_histogram(SHORT_PRESS, 0, 1);
+    
+    BUTTON_MATRIX_resetLatencyHistogram();
+    pass = pass && bmCheck_histogram(LONG_PRESS, 0, 0) && bmCheck_histogram(SHORT_PRESS, 0, 0);
+    bmCheck_tap(1, 50, 400);
+    pass = pass && bmCheck_histogram(LONG_PRESS, 0, 0) && bmCheck_histogram(SHORT_PRESS, 0, 1);
+    
+    for(uint32_t i = 0; i < 70000UL; i++)
+    {
+        bmCheck_edge(1, BM_BUTTON_PRESSED);
+        bmCheck_edge(1, BM_BUTTON_RELEASED);
+    }
+    pass = pass && bmCheck_histogram(SHORT_PRESS, 0, UINT16_MAX);
+    pass = pass && !BUTTON_MATRIX_getLatencyHistogram(BM_EVENT_TYPES, NULL);
+    
+    bmCheck_end("histogram: reset, bins stop at 65535", pass);
+}
+#endif
+
+int main(void)
+{
+#if !CFG_RAW_EVENTS && !CFG_MULTI_TAP
+    bmCheck_queueOrder();
+    bmCheck_queueOverflow();
+    bmCheck_queueRead();
+    bmCheck_queueDropLimit();
+#if CFG_DEFERRED_DISPATCH
+    bmCheck_deferredOverflow();
+#endif
+#endif
+#if CFG_RAW_EVENTS
+    bmCheck_rawShortPress();
+    bmCheck_rawChord();
+    bmCheck_rawRepeatedEdge();
+    bmCheck_rawLongPress();
+#endif
+#if CFG_AUTO_REPEAT
+    bmCheck_repeatSequence();
+    bmCheck_repeatLongPress();
+    bmCheck_repeatNewestKey();
+    bmCheck_repeatOlderRelease();
+#endif
+#if CFG_MULTI_TAP
+    bmCheck_tapWindow();
+    bmCheck_tapCount();
+    bmCheck_tapInterrupted();
+    bmCheck_tapDelayed();
+#endif
+#if CFG_SUBSCRIBERS
+    bmCheck_subscriberMasks();
+    bmCheck_subscriberTable();
+    bmCheck_subscriberChange();
+#endif
+#if CFG_LATENCY_HISTOGRAM
+    bmCheck_histogramBins();
+    bmCheck_histogramScan();
+    bmCheck_histogramReset();
+#endif
+    
+    printf("cases                %10u\n", cases);
+    printf("failures             %10u\n", failures);
+    
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+/**
+ * \file bm_check_timer.c
+ *
+ * \brief Host check of the RTC timer service of button_matrix_timer.c.
+ *
+ * Starts, restarts and stops every timer slot at random times on the
+ * simulated RTC, with delays from a few ticks to several RTC periods, and
+ * checks each expiry against a model of the slots: no timer may expire
+ * before its deadline, more than the compare lead after it, or after it was
+ * stopped or started again. With CFG_DEFERRED_DISPATCH, the expiries are run
+ * through bmTimer_run only after the next random operations, so stale ones
+ * have to be dropped.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bm_sim.h"
+#include "button_matrix_timer.h"
+
+/* BM_TIMER_MIN_LEAD of button_matrix_timer.c: a deadline closer than this to the compare write expires this late */
+#define BM_CHECK_LEAD           4
+
+typedef struct {
+    bool armed;             /* started and not yet expired or stopped */
+    bool pending;           /* expired and waiting for bmTimer_run, deferred dispatch only */
+    uint32_t deadline;
+    uint32_t start;         /* tick the slot was started at */
+    uint32_t due;           /* the deadline, or the start when the deadline had already passed */
+    uint32_t latest;        /* last tick the expiry may come at */
+} bm_check_slot_t;
+
+static bm_check_slot_t slots[BM_TIMER_SLOTS];
+static uint32_t seed = 1;
+static uint64_t starts;
+static uint64_t stops;
+static uint64_t restarts;
+static uint64_t expiries;
+static uint64_t failures;
+static uint32_t maxLate;
+
+#if CFG_DEFERRED_DISPATCH
+static struct {
+    uint8_t slot;
+    uint8_t generation;
+} expired[BM_TIMER_SLOTS];
+static uint8_t expiredCount;
+static uint64_t staleRuns;
+#endif
+
+/* xorshift32, so a seed gives the same operations on every host */
+static uint32_t bmCheck_random(uint32_t range)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return seed % range;
+}
+
+/* From a few ticks, which the compare lead pushes out, to several RTC periods */
+static uint32_t bmCheck_delay(void)
+{
+    switch(bmCheck_random(4))
+    {
+        case 0:
+            return bmCheck_random(2 * BM_CHECK_LEAD);
+        case 1:
+            return bmCheck_random(200);
+        case 2:
+            return bmCheck_random(0x10000);
+        default:
+            return 0x10000 + bmCheck_random(0x30000);
+    }
+}
+
+static void bmCheck_fail(const char *what, uint8_t slot)
+{
+    if(failures < 10)
+    {
+        printf("FAIL: slot %u %s at tick %u, deadline %u\n", slot, what, bmTimer_now(), slots[slot].deadline);
+    }
+    failures++;
+}
+
+/* Any start or stop may rewrite the compare channel, which pushes the deadlines due before the lead out to it */
+static void bmCheck_compareWritten(void)
+{
+    uint32_t now = bmTimer_now();
+    
+    for(uint8_t slot = 0; slot < BM_TIMER_SLOTS; slot++)
+    {
+        if(slots[slot].armed && ((int32_t)(slots[slot].latest - (now + BM_CHECK_LEAD)) < 0))
+        {
+            slots[slot].latest = now + BM_CHECK_LEAD;
+        }
+    }
+}
+
+static void bmCheck_arm(uint8_t slot, uint32_t deadline)
+{
+    uint32_t now = bmTimer_now();
+    
+    slots[slot].armed = true;
+    slots[slot].pending = false;
+    slots[slot].deadline = deadline;
+    slots[slot].start = now;
+    slots[slot].due = ((int32_t)(deadline - now) > 0) ? deadline : now;
+    slots[slot].latest = slots[slot].due + BM_CHECK_LEAD;
+    bmCheck_compareWritten();
+}
+
+/* Last tick the expiry may come at; the overflow interrupt writes the compare channel too, every 0x10000 ticks */
+static uint32_t bmCheck_latest(uint8_t slot, uint32_t now)
+{
+    uint32_t overflow = now & 0xFFFF0000UL;
+    
+    if(((int32_t)(overflow - slots[slot].start) >= 0) && ((int32_t)(slots[slot].latest - (overflow + BM_CHECK_LEAD)) < 0))
+    {
+        return overflow + BM_CHECK_LEAD;
+    }
+    
+    return slots[slot].latest;
+}
+
+/* Checks that an expiry of slot is due now */
+static void bmCheck_expire(uint8_t slot)
+{
+    uint32_t now = bmTimer_now();
+    
+    if(!slots[slot].armed)
+    {
+        bmCheck_fail("expired while not running", slot);
+    }
+    else if((int32_t)(now - slots[slot].deadline) < 0)
+    {
+        bmCheck_fail("expired early", slot);
+    }
+    else if((int32_t)(now - bmCheck_latest(slot, now)) > 0)
+    {
+        bmCheck_fail("expired late", slot);
+    }
+    else if((now - slots[slot].due) > maxLate)
+    {
+        maxLate = now - slots[slot].due;
+    }
+    slots[slot].armed = false;
+    expiries++;
+}
+
+/* Timer callback; sometimes rearms itself one period after its deadline, as the auto-repeat does */
+static void bmCheck_callback(uint8_t slot)
+{
+    uint32_t period;
+    
+#if CFG_DEFERRED_DISPATCH
+    if(!slots[slot].pending)
+    {
+        bmCheck_fail("ran a stale expiry", slot);
+    }
+    slots[slot].pending = false;
+#else
+    bmCheck_expire(slot);
+#endif
+    
+    if(bmCheck_random(4) == 0)
+    {
+        period = bmCheck_delay();
+        bmTimer_restart(slot, period);
+        bmCheck_arm(slot, slots[slot].deadline + period);
+        restarts++;
+    }
+}
+
+#if CFG_DEFERRED_DISPATCH
+/* RTC interrupt: the expiry is only recorded, bmCheck_runExpired runs it later */
+static void bmCheck_expiredHandler(uint8_t slot, uint8_t generation)
+{
+    bmCheck_expire(slot);
+    slots[slot].pending = true;
+    expired[expiredCount].slot = slot;
+    expired[expiredCount].generation = generation;
+    expiredCount++;
+}
+
+static void bmCheck_runExpired(void)
+{
+    uint8_t count = expiredCount;
+    uint8_t slot;
+    
+    expiredCount = 0;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        slot = expired[i].slot;
+        if(!slots[slot].pending)
+        {
+            staleRuns++;
+        }
+        bmTimer_run(slot, expired[i].generation);
+    }
+}
+#endif
+
+/* A random start, start from a base in the past, or stop of a random slot */
+static void bmCheck_operation(void)
+{
+    uint8_t slot = (uint8_t)bmCheck_random(BM_TIMER_SLOTS);
+    uint32_t delay = bmCheck_delay();
+    uint32_t base;
+    
+    switch(bmCheck_random(3))
+    {
+        case 0:
+            bmTimer_start(slot, delay, bmCheck_callback, slot);
+            bmCheck_arm(slot, bmTimer_deadline(slot));
+            starts++;
+            break;
+        case 1:
+            base = bmTimer_now() - bmCheck_random(400);
+            bmTimer_startAt(slot, base, delay, bmCheck_callback, slot);
+            bmCheck_arm(slot, base + delay);
+            starts++;
+            break;
+        default:
+            bmTimer_stop(slot);
+            slots[slot].armed = false;
+            slots[slot].pending = false;
+            bmCheck_compareWritten();
+            stops++;
+            break;
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-t TICKS] [-s SEED]\n"
+            "  Starts and stops the timer slots at random for TICKS RTC ticks\n"
+            "  (60000000 by default) and checks every expiry.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    /* Longest virtual time between two operations: within a tick, a few ticks, a scan, a short press, and rarely a pause over an RTC period */
+    static const uint64_t steps[] = {BM_SIM_US(20), BM_SIM_US(200), BM_SIM_MS(5), BM_SIM_MS(50), BM_SIM_S(3)};
+    uint64_t step;
+    uint32_t ticks = 60000000UL;
+    uint32_t now;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "t:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 't':
+                ticks = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                if(seed == 0)
+                {
+                    seed = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    
+    bmSim_reset();
+    bmTimer_init();
+#if CFG_DEFERRED_DISPATCH
+    bmTimer_setExpiredHandler(bmCheck_expiredHandler);
+#endif
+    
+    while(bmTimer_now() < ticks)
+    {
+        step = steps[(bmCheck_random(512) == 0) ? 4 : bmCheck_random(4)];
+        bmSim_runUntil(bmSim_now() + 1 + (bmCheck_random(0x10000) * step) / 0x10000);
+        
+        /* Every slot whose last tick has passed must have expired by now */
+        now = bmTimer_now();
+        for(uint8_t slot = 0; slot < BM_TIMER_SLOTS; slot++)
+        {
+            if(slots[slot].armed && ((int32_t)(now - bmCheck_latest(slot, now)) > 0))
+            {
+                bmCheck_fail("missed", slot);
+                slots[slot].armed = false;
+            }
+        }
+        
+        for(uint32_t count = bmCheck_random(3); count > 0; count--)
+        {
+            bmCheck_operation();
+        }
+#if CFG_DEFERRED_DISPATCH
+        bmCheck_runExpired();
+#endif
+    }
+    
+    printf("ticks                %10u\n", bmTimer_now());
+    printf("slots                %10u\n", (unsigned)BM_TIMER_SLOTS);
+    printf("starts               %10llu (%llu restarts from a callback)\n", (unsigned long long)starts, (unsigned long long)restarts);
+    printf("stops                %10llu\n", (unsigned long long)stops);
+    printf("expiries             %10llu, at most %u ticks after the deadline or the start\n", (unsigned long long)expiries, maxLate);
+#if CFG_DEFERRED_DISPATCH
+    printf("stale expiries       %10llu dropped by bmTimer_run\n", (unsigned long long)staleRuns);
+#endif
+    printf("failures             %10llu\n", (unsigned long long)failures);
+    
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+/**
+ * \file bm_hal_host.c
+ *
+ * \brief Button matrix hardware abstraction on a simulated matrix and a virtual clock.
+ *
+ * The matrix is modelled with a diode on every key, so there is no ghosting:
+ * a row reads low when at least one driven column has a closed key on it.
+ * The scan timer overflows every BM_SCAN_PERIOD_US while it runs, and the RTC
+ * counts BM_TIMER_TICKS_PER_S from the call to bmHal_startTicks. Interrupts
+ * are served in time order; interrupts due at the same time are served
+ * overflow first, then compare, then scan.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+#include "bm_sim.h"
+
+#define BM_SIM_SCAN_PERIOD      BM_SIM_US(BM_SCAN_PERIOD_US)
+#define BM_SIM_NEVER            UINT64_MAX
+
+/* Same order as BUTTON_MATRIX_event_t */
+const char *const bmSim_eventNames[BM_EVENT_TYPES] = {
+    "NONE", "ERROR", "SHORT_PRESS", "LONG_PRESS", "MULTIPLE_SHORT_PRESS", "MULTIPLE_LONG_PRESS",
+    "PRESS", "RELEASE", "REPEAT", "DOUBLE_TAP", "N_TAP", "SEQUENCE"
+};
+
+static uint64_t now;
+static bm_sim_stats_t stats;
+static bool scanTiming;
+
+/* Matrix: bit (key - 1) set while the key is closed, bit n set while column n is driven low */
+static BUTTON_MATRIX_state_t closedKeys;
+static uint8_t drivenColumns;
+static bool rowWakeEnabled;
+
+/* Scan timer */
+static bmHal_cb_t scanHandler;
+static uint64_t nextScan;
+
+/* Tick counter: 32-bit tick n starts at tickBase + ceil(n * 1e9 / BM_TIMER_TICKS_PER_S) */
+static bool ticksRunning;
+static uint64_t tickBase;
+static uint64_t tickOverflowsServed;
+static bmHal_cb_t tickOverflowHandler;
+static bmHal_cb_t tickCompareHandler;
+static bool compareEnabled;
+static uint64_t compareTick;
+
+static uint64_t ticksAt(uint64_t time)
+{
+    return ((time - tickBase) * BM_TIMER_TICKS_PER_S) / 1000000000ULL;
+}
+
+static uint64_t timeOfTick(uint64_t tick)
+{
+    return tickBase + ((tick * 1000000000ULL) + BM_TIMER_TICKS_PER_S - 1) / BM_TIMER_TICKS_PER_S;
+}
+
+void bmHal_portInit(void)
+{
+    drivenColumns = 0;
+    rowWakeEnabled = false;
+}
+
+void bmHal_driveColumn(uint8_t column)
+{
+    drivenColumns |= (uint8_t)(1 << column);
+}
+
+void bmHal_releaseColumn(uint8_t column)
+{
+    drivenColumns &= (uint8_t)~(1 << column);
+}
+
+uint8_t bmHal_readRows(void)
+{
+    uint8_t levels = BM_ROW_LEVELS_MASK;
+    
+    for(uint8_t row = 0; row < CFG_ROWS; row++)
+    {
+        for(uint8_t column = 0; column < CFG_COLUMNS; column++)
+        {
+            if((drivenColumns & (1 << column)) && (closedKeys & BUTTON_MATRIX_KEY(column + (row * CFG_COLUMNS) + 1)))
+            {
+                levels &= (uint8_t)~(1 << row);
+                break;
+            }
+        }
+    }
+    
+    return levels;
+}
+
+void bmHal_enableRowWake(void)
+{
+    rowWakeEnabled = true;
+}
+
+void bmHal_disableRowWake(void)
+{
+    rowWakeEnabled = false;
+}
+
+void bmHal_setScanHandler(bmHal_cb_t handler)
+{
+    scanHandler = handler;
+    nextScan = now + BM_SIM_SCAN_PERIOD;
+}
+
+void bmHal_stopScan(void)
+{
+    nextScan = BM_SIM_NEVER;
+}
+
+void bmHal_restartScan(void)
+{
+    nextScan = now + BM_SIM_SCAN_PERIOD;
+}
+
+void bmHal_startTicks(bmHal_cb_t overflow, bmHal_cb_t compare)
+{
+    tickOverflowHandler = overflow;
+    tickCompareHandler = compare;
+    tickBase = now;
+    tickOverflowsServed = 0;
+    compareEnabled = false;
+    ticksRunning = true;
+}
+
+uint16_t bmHal_readTicks(void)
+{
+    return (uint16_t)ticksAt(now);
+}
+
+/* True between the wrap of the counter and the overflow interrupt, when both fall on the same time */
+bool bmHal_ticksOverflowPending(void)
+{
+    return (ticksAt(now) >> 16) != tickOverflowsServed;
+}
+
+/* Compare writes take effect at once on the host */
+bool bmHal_tickCompareBusy(void)
+{
+    return false;
+}
+
+/* Matches the first time the counter reaches ticks after now */
+void bmHal_setTickCompare(uint16_t ticks)
+{
+    uint64_t current = ticksAt(now);
+    
+    compareTick = (current & ~(uint64_t)0xFFFF) | ticks;
+    if(compareTick <= current)
+    {
+        compareTick += 0x10000;
+    }
+    compareEnabled = true;
+}
+
+void bmHal_disableTickCompare(void)
+{
+    compareEnabled = false;
+}
+
+#if CFG_SCAN_LATENCY_PROBE
+/* The simulated scan handler starts on the overflow itself */
+void bmHal_initLatencyProbe(void)
+{
+}
+
+uint16_t bmHal_readLatencyProbe(void)
+{
+    return 0;
+}
+#endif
+
+#if CFG_PROFILER
+/* The host has no cycle counter to spare; the profile is in nanoseconds of the monotonic clock */
+void bmHal_initProfileTimer(void)
+{
+}
+
+uint16_t bmHal_readProfileTimer(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (uint16_t)now.tv_nsec;
+}
+#endif
+
+/* All keys open, clock at zero and every peripheral stopped; call it before BUTTON_MATRIX_init */
+void bmSim_reset(void)
+{
+    now = 0;
+    memset(&stats, 0, sizeof(stats));
+    closedKeys = 0;
+    drivenColumns = 0;
+    rowWakeEnabled = false;
+    scanHandler = NULL;
+    nextScan = BM_SIM_NEVER;
+    ticksRunning = false;
+    compareEnabled = false;
+    scanTiming = false;
+}
+
+/*
+ * Closes or opens the contact of a key (1 based). A row edge while the rows
+ * are sensed wakes the CPU up, and the main loop runs BUTTON_MATRIX_Tasks.
+ */
+void bmSim_setKey(uint8_t key, bool closed)
+{
+    uint8_t before = bmHal_readRows();
+    
+    if(closed)
+    {
+        closedKeys |= BUTTON_MATRIX_KEY(key);
+    }
+    else
+    {
+        closedKeys &= ~BUTTON_MATRIX_KEY(key);
+    }
+    
+    if(rowWakeEnabled && (bmHal_readRows() != before))
+    {
+        stats.rowWakes++;
+        BUTTON_MATRIX_Tasks();
+    }
+}
+
+bool bmSim_getKey(uint8_t key)
+{
+    return (closedKeys & BUTTON_MATRIX_KEY(key)) != 0;
+}
+
+uint64_t bmSim_now(void)
+{
+    return now;
+}
+
+/* Virtual time of an event timestamp, taken as the last 32-bit tick count */
+uint64_t bmSim_timeOfTimestamp(uint32_t timestamp)
+{
+    uint64_t tick = (ticksAt(now) & ~(uint64_t)UINT32_MAX) | timestamp;
+    
+    if(tick > ticksAt(now))
+    {
+        tick -= (uint64_t)UINT32_MAX + 1;
+    }
+    return timeOfTick(tick);
+}
+
+/* Host time of one scan handler call; the clock reads themselves add some tens of ns */
+static void bmSim_timedScan(void)
+{
+    struct timespec start;
+    struct timespec end;
+    uint64_t elapsed;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    scanHandler();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    elapsed = ((uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL) + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+    stats.scanTime += elapsed;
+    if(elapsed > stats.scanTimeMax)
+    {
+        stats.scanTimeMax = elapsed;
+    }
+}
+
+/* Serves every interrupt due up to time, then leaves the clock at time */
+void bmSim_runUntil(uint64_t time)
+{
+    uint64_t overflowAt;
+    uint64_t compareAt;
+    uint64_t servedTick;
+    
+    while(1)
+    {
+        overflowAt = ticksRunning ? timeOfTick((tickOverflowsServed + 1) << 16) : BM_SIM_NEVER;
+        compareAt = (ticksRunning && compareEnabled) ? timeOfTick(compareTick) : BM_SIM_NEVER;
+        
+        if((overflowAt <= time) && (overflowAt <= compareAt) && (overflowAt <= nextScan))
+        {
+            now = overflowAt;
+            tickOverflowsServed++;
+            stats.tickOverflows++;
+            tickOverflowHandler();
+        }
+        else if((compareAt <= time) && (compareAt <= nextScan))
+        {
+            now = compareAt;
+            servedTick = compareTick;
+            stats.tickCompares++;
+            tickCompareHandler();
+            /* Not reprogrammed: the counter matches again one period later */
+            if(compareEnabled && (compareTick == servedTick))
+            {
+                compareTick += 0x10000;
+            }
+        }
+        else if(nextScan <= time)
+        {
+            now = nextScan;
+            nextScan += BM_SIM_SCAN_PERIOD;
+            stats.scans++;
+            if(scanTiming)
+            {
+                bmSim_timedScan();
+            }
+            else
+            {
+                scanHandler();
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    
+    now = time;
+}
+
+void bmSim_getStats(bm_sim_stats_t *out)
+{
+    *out = stats;
+}
+
+/* Measures every scan handler call in host time, see scanTime and scanTimeMax */
+void bmSim_setScanTiming(bool enable)
+{
+    scanTiming = enable;
+}
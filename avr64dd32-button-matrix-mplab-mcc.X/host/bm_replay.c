@@ -0,0 +1,477 @@
+/**
+ * \file bm_replay.c
+ *
+ * \brief Replays recorded raw key traces through the button matrix stack on the host.
+ *
+ * A trace is a text file with one line per raw contact change, bounce
+ * included, in time order:
+ *
+ *     <time us> <key> <level>              level 1: contact closed, 0: open
+ *
+ * and, optionally, ground truth annotations of the events the trace should
+ * produce, at the time the user started the action:
+ *
+ *     <time us> = <EVENT> <btn1> [<btn2>]  e.g. 1250000 = SHORT_PRESS 5
+ *
+ * Lines starting with '#' are comments. The contact changes drive the
+ * simulated matrix, so every edge goes through the scan handler, the debounce
+ * and the classifier exactly as on the device.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bm_sim.h"
+
+#define BM_REPLAY_LINE_SIZE     128
+#define BM_REPLAY_NO_ONSET      UINT64_MAX
+#define BM_REPLAY_BATCH         16
+#define BM_REPLAY_KEYS          (CFG_ROWS * CFG_COLUMNS)
+
+/* Growable array of 32-bit values */
+typedef struct {
+    uint32_t *values;
+    size_t count;
+    size_t size;
+} bm_list_t;
+
+/* Ground truth annotation */
+typedef struct {
+    uint64_t time;
+    uint8_t event;
+    uint8_t btn1;
+    uint8_t btn2;
+    bool matched;
+} bm_expected_t;
+
+static bool verbose;
+static bool quiet;
+static uint64_t window = BM_SIM_MS(3000);
+
+/* First raw close of the press in progress on each physical key */
+static uint64_t onset[BM_REPLAY_KEYS + 1];
+
+static uint64_t eventCount[BM_EVENT_TYPES];
+static bm_list_t latency[BM_EVENT_TYPES];       /* us from the press onset of btn1 to the dispatch */
+static bm_list_t truthLatency;                  /* us from the annotation to the matching dispatch */
+static bm_list_t stampError;                    /* us between the press time an event reports and its annotation */
+
+static bm_expected_t *expected;
+static size_t expectedCount;
+static size_t expectedSize;
+static size_t firstOpen;                        /* expected entries before it are matched or expired */
+static uint64_t spurious;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-v] [-q] [-w MS] [TRACE]\n"
+            "  Replays a raw key trace (stdin when no path is given) through the scan,\n"
+            "  the debounce and the classifier, and reports the events, their latency,\n"
+            "  the missed and spurious events against the annotations and the host\n"
+            "  time per scan.\n"
+            "  -v  print every event\n"
+            "  -q  print only the summary\n"
+            "  -w  longest time from an annotation to its event, 3000 ms by default\n", name);
+}
+
+static void bmList_add(bm_list_t *list, uint32_t value)
+{
+    if(list->count == list->size)
+    {
+        list->size = (list->size != 0) ? (list->size * 2) : 256;
+        list->values = realloc(list->values, list->size * sizeof(uint32_t));
+        if(list->values == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    list->values[list->count++] = value;
+}
+
+static int bmList_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    
+    return (x > y) - (x < y);
+}
+
+/* Sorts the list and prints count, min, percentiles and max in ms */
+static void bmList_print(const char *name, bm_list_t *list)
+{
+    uint32_t *v = list->values;
+    size_t n = list->count;
+    
+    if(n == 0)
+    {
+        return;
+    }
+    qsort(v, n, sizeof(uint32_t), bmList_compare);
+    printf("  %-20s %8zu %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, n, v[0] / 1000.0, v[n / 2] / 1000.0,
+           v[(n * 9) / 10] / 1000.0, v[(n * 99) / 100] / 1000.0, v[n - 1] / 1000.0);
+}
+
+static bool bmReplay_sameButtons(const bm_expected_t *e, uint8_t btn1, uint8_t btn2)
+{
+    return ((e->btn1 == btn1) && (e->btn2 == btn2)) || ((e->btn1 == btn2) && (e->btn2 == btn1));
+}
+
+/*
+ * Compares the press time a SHORT_PRESS or LONG_PRESS reports, its timestamp
+ * less its duration, with the annotated start of the action
+ */
+static void bmReplay_stampError(const BUTTON_MATRIX_eventRecord_t *record, uint64_t start)
+{
+    uint64_t stamp;
+    
+    if((record->event != SHORT_PRESS) && (record->event != LONG_PRESS))
+    {
+        return;
+    }
+    stamp = bmSim_timeOfTimestamp(record->timestamp) - BM_SIM_MS(record->duration);
+    bmList_add(&stampError, (uint32_t)(((stamp > start) ? (stamp - start) : (start - stamp)) / 1000));
+}
+
+/* Matches an emitted event with the oldest open annotation of the same event and buttons */
+static bool bmReplay_match(const BUTTON_MATRIX_eventRecord_t *record, uint64_t now)
+{
+    while((firstOpen < expectedCount) && (expected[firstOpen].matched || (expected[firstOpen].time + window < now)))
+    {
+        firstOpen++;
+    }
+    
+    for(size_t i = firstOpen; (i < expectedCount) && (expected[i].time <= now); i++)
+    {
+        if(!expected[i].matched && (expected[i].time + window >= now) && (expected[i].event == record->event) &&
+           bmReplay_sameButtons(&expected[i], record->btn1, record->btn2))
+        {
+            expected[i].matched = true;
+            bmList_add(&truthLatency, (uint32_t)((now - expected[i].time) / 1000));
+            bmReplay_stampError(record, expected[i].time);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+/* Record callback: runs when the event is dispatched, so bmSim_now() is its virtual dispatch time */
+static void bmReplay_event(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    uint64_t now = bmSim_now();
+    bool matched = true;
+    
+    eventCount[record->event]++;
+    if((record->btn1 >= 1) && (record->btn1 <= BM_REPLAY_KEYS) && (onset[record->btn1] != BM_REPLAY_NO_ONSET))
+    {
+        bmList_add(&latency[record->event], (uint32_t)((now - onset[record->btn1]) / 1000));
+    }
+    if(expectedCount != 0)
+    {
+        matched = bmReplay_match(record, now);
+        if(!matched)
+        {
+            spurious++;
+        }
+    }
+    
+    if(verbose || (!matched && !quiet))
+    {
+        printf("%12.3f ms %-20s %2u %2u keys=%04lx %5u ms x%u%s\n", now / 1e6, bmSim_eventNames[record->event],
+               record->btn1, record->btn2, (unsigned long)record->keys, record->duration, record->count,
+               matched ? "" : "  SPURIOUS");
+    }
+}
+
+/* A key whose debounced state and contact are both released has no press in progress */
+static void bmReplay_updateOnsets(void)
+{
+    BUTTON_MATRIX_state_t state = BUTTON_MATRIX_getState();
+    
+    for(uint8_t key = 1; key <= BM_REPLAY_KEYS; key++)
+    {
+        if(!(state & BUTTON_MATRIX_KEY(key)) && !bmSim_getKey(key))
+        {
+            onset[key] = BM_REPLAY_NO_ONSET;
+        }
+    }
+}
+
+/* Advances the simulation; with deferred dispatch, the main loop runs at least every millisecond */
+static void bmReplay_runUntil(uint64_t time)
+{
+    BUTTON_MATRIX_eventRecord_t events[BM_REPLAY_BATCH];
+    
+#if CFG_DEFERRED_DISPATCH
+    while(bmSim_now() + BM_SIM_MS(1) < time)
+    {
+        bmSim_runUntil(bmSim_now() + BM_SIM_MS(1));
+        BUTTON_MATRIX_Tasks();
+    }
+#endif
+    bmSim_runUntil(time);
+    BUTTON_MATRIX_Tasks();
+    
+    /* The events were seen by the record callback; only keep the queue from filling up */
+    while(BUTTON_MATRIX_readEvents(events, BM_REPLAY_BATCH) != 0)
+    {
+        ;
+    }
+}
+
+#if CFG_LATENCY_HISTOGRAM
+/* The histogram the library keeps, from the raw edge of btn1 to the callbacks, for comparison */
+static void bmReplay_printHistogram(void)
+{
+    uint16_t bins[BM_LATENCY_BINS];
+    bool header = false;
+    
+    for(uint8_t event = 0; event < BM_EVENT_TYPES; event++)
+    {
+        uint32_t total = 0;
+        
+        BUTTON_MATRIX_getLatencyHistogram(event, bins);
+        for(uint8_t i = 0; i < BM_LATENCY_BINS; i++)
+        {
+            total += bins[i];
+        }
+        if(total == 0)
+        {
+            continue;
+        }
+        
+        if(!header)
+        {
+            header = true;
+            printf("library latency histogram, events per bin starting at ms:\n  %-20s %5s", "event", "0");
+            for(uint8_t i = 1; i < BM_LATENCY_BINS; i++)
+            {
+                printf(" %5lu", 1UL << (i - 1));
+            }
+            printf("\n");
+        }
+        printf("  %-20s", bmSim_eventNames[event]);
+        for(uint8_t i = 0; i < BM_LATENCY_BINS; i++)
+        {
+            printf(" %5u", bins[i]);
+        }
+        printf("\n");
+    }
+}
+#endif
+
+static uint8_t bmReplay_eventByName(const char *name)
+{
+    for(uint8_t i = 0; i < BM_EVENT_TYPES; i++)
+    {
+        if(strcmp(name, bmSim_eventNames[i]) == 0)
+        {
+            return i;
+        }
+    }
+    
+    return NONE;
+}
+
+static void bmReplay_expect(uint64_t time, uint8_t event, uint8_t btn1, uint8_t btn2)
+{
+    if(expectedCount == expectedSize)
+    {
+        expectedSize = (expectedSize != 0) ? (expectedSize * 2) : 256;
+        expected = realloc(expected, expectedSize * sizeof(bm_expected_t));
+        if(expected == NULL)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    expected[expectedCount].time = time;
+    expected[expectedCount].event = event;
+    expected[expectedCount].btn1 = btn1;
+    expected[expectedCount].btn2 = btn2;
+    expected[expectedCount].matched = false;
+    expectedCount++;
+}
+
+int main(int argc, char **argv)
+{
+    char line[BM_REPLAY_LINE_SIZE];
+    char name[32];
+    FILE *trace = stdin;
+    struct timespec start;
+    struct timespec end;
+    bm_sim_stats_t stats;
+    unsigned long lineNumber = 0;
+    unsigned long edges = 0;
+    uint64_t missed = 0;
+    uint64_t time;
+    double elapsed;
+    double us;
+    unsigned key;
+    unsigned level;
+    unsigned btn1;
+    unsigned btn2;
+    int fields;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "vqw:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'v':
+                verbose = true;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'w':
+                window = BM_SIM_MS(strtoull(optarg, NULL, 0));
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if(optind < argc)
+    {
+        trace = fopen(argv[optind], "r");
+        if(trace == NULL)
+        {
+            fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+    }
+    
+    for(uint8_t i = 0; i <= BM_REPLAY_KEYS; i++)
+    {
+        onset[i] = BM_REPLAY_NO_ONSET;
+    }
+    bmSim_reset();
+    bmSim_setScanTiming(true);
+    BUTTON_MATRIX_setRecordCallback(bmReplay_event);
+    BUTTON_MATRIX_init();
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(fgets(line, sizeof(line), trace) != NULL)
+    {
+        lineNumber++;
+        if((line[0] == '#') || (sscanf(line, "%lf", &us) != 1))
+        {
+            continue;
+        }
+        time = (uint64_t)(us * 1000.0);
+        if(time < bmSim_now())
+        {
+            fprintf(stderr, "line %lu: time goes backwards\n", lineNumber);
+            return 1;
+        }
+        
+        /* Annotations are read ahead of the edges at the same time, so they are known before their event */
+        fields = sscanf(line, "%lf = %31s %u %u", &us, name, &btn1, &btn2);
+        if(fields >= 3)
+        {
+            if(bmReplay_eventByName(name) == NONE)
+            {
+                fprintf(stderr, "line %lu: unknown event %s\n", lineNumber, name);
+                return 1;
+            }
+            bmReplay_expect(time, bmReplay_eventByName(name), (uint8_t)btn1, (fields == 4) ? (uint8_t)btn2 : BM_NULL_BTN);
+            continue;
+        }
+        if((sscanf(line, "%lf %u %u", &us, &key, &level) != 3) || (key < 1) || (key > BM_REPLAY_KEYS) || (level > 1))
+        {
+            fprintf(stderr, "line %lu: expected <time us> <key> <level> or <time us> = <EVENT> <btn1> [<btn2>]\n", lineNumber);
+            return 1;
+        }
+        
+        bmReplay_runUntil(time);
+        bmReplay_updateOnsets();
+        if(level && !bmSim_getKey((uint8_t)key) && (onset[key] == BM_REPLAY_NO_ONSET))
+        {
+            onset[key] = time;
+        }
+        bmSim_setKey((uint8_t)key, level != 0);
+        edges++;
+    }
+    /* Let the last presses, long presses and timers finish */
+    bmReplay_runUntil(bmSim_now() + window);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    if(trace != stdin)
+    {
+        fclose(trace);
+    }
+    
+    for(size_t i = 0; i < expectedCount; i++)
+    {
+        if(!expected[i].matched)
+        {
+            missed++;
+            if(!quiet)
+            {
+                printf("%12.3f ms %-20s %2u %2u  MISSED\n", expected[i].time / 1e6, bmSim_eventNames[expected[i].event],
+                       expected[i].btn1, expected[i].btn2);
+            }
+        }
+    }
+    
+    elapsed = (double)(end.tv_sec - start.tv_sec) + ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+    bmSim_getStats(&stats);
+    
+    printf("trace                %10lu edges, %.1f s\n", edges, (double)bmSim_now() / 1e9);
+    printf("latency from the first contact of btn1 to the event, ms:\n");
+    printf("  %-20s %8s %8s %8s %8s %8s %8s\n", "event", "count", "min", "p50", "p90", "p99", "max");
+    for(uint8_t i = 0; i < BM_EVENT_TYPES; i++)
+    {
+        bmList_print(bmSim_eventNames[i], &latency[i]);
+        if((eventCount[i] != 0) && (latency[i].count == 0))
+        {
+            printf("  %-20s %8llu\n", bmSim_eventNames[i], (unsigned long long)eventCount[i]);
+        }
+    }
+#if CFG_LATENCY_HISTOGRAM
+    bmReplay_printHistogram();
+#endif
+    if(expectedCount != 0)
+    {
+        printf("ground truth         %10zu expected, %zu matched, %llu missed, %llu spurious\n", expectedCount,
+               expectedCount - (size_t)missed, (unsigned long long)missed, (unsigned long long)spurious);
+        printf("latency from the annotation to the matching event, ms:\n");
+        bmList_print("matched", &truthLatency);
+        printf("press time reported by SHORT_PRESS and LONG_PRESS, error from the annotation, ms:\n");
+        bmList_print("press", &stampError);
+    }
+    printf("events dropped       %10u\n", BUTTON_MATRIX_getDroppedEvents());
+    printf("scans                %10llu\n", (unsigned long long)stats.scans);
+    if(stats.scans != 0)
+    {
+        printf("host time per scan   %10.1f ns mean, %llu ns max\n", (double)stats.scanTime / (double)stats.scans,
+               (unsigned long long)stats.scanTimeMax);
+    }
+    printf("host time            %10.3f s\n", elapsed);
+    
+    return ((missed != 0) || (spurious != 0)) ? 3 : 0;
+}
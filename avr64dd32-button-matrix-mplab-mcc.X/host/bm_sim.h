@@ -0,0 +1,73 @@
+/**
+ * \file bm_sim.h
+ *
+ * \brief Simulated button matrix, scan timer and tick counter for the host build.
+ *
+ * The simulation implements button_matrix_hal.h. Keys are closed and opened
+ * with bmSim_setKey, and bmSim_runUntil advances a virtual clock, calling the
+ * scan and RTC handlers at the times the hardware would. A row edge while the
+ * rows are sensed runs BUTTON_MATRIX_Tasks, like the main loop after the pin
+ * change woke the CPU up.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_SIM_H
+#define	BM_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix.h"
+
+/* Virtual time is counted in nanoseconds */
+#define BM_SIM_US(us)           ((uint64_t)(us) * 1000ULL)
+#define BM_SIM_MS(ms)           ((uint64_t)(ms) * 1000000ULL)
+#define BM_SIM_S(s)             ((uint64_t)(s) * 1000000000ULL)
+
+/* Interrupts served by the simulation so far */
+typedef struct {
+    uint64_t scans;             /* scan timer overflows */
+    uint64_t tickOverflows;     /* RTC overflows */
+    uint64_t tickCompares;      /* RTC compare matches */
+    uint64_t rowWakes;          /* row pin change interrupts */
+    uint64_t scanTime;          /* host ns spent in the scan handler, with bmSim_setScanTiming */
+    uint64_t scanTimeMax;       /* longest scan handler call, in host ns */
+} bm_sim_stats_t;
+
+/* Names of the BUTTON_MATRIX_event_t values, as printed by the host programs */
+extern const char *const bmSim_eventNames[BM_EVENT_TYPES];
+
+void bmSim_reset(void);
+void bmSim_setKey(uint8_t key, bool closed);
+bool bmSim_getKey(uint8_t key);
+uint64_t bmSim_now(void);
+uint64_t bmSim_timeOfTimestamp(uint32_t timestamp);
+void bmSim_runUntil(uint64_t time);
+void bmSim_getStats(bm_sim_stats_t *stats);
+void bmSim_setScanTiming(bool enable);
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* BM_SIM_H */
@@ -0,0 +1,318 @@
+/**
+ * \file bm_test_frame.c
+ *
+ * \brief Round trip of random event records through BUTTON_MATRIX_encodeFrame
+ *        and the decoder of tools/bm_decode.
+ *
+ * Encodes random records, with time steps from a fraction of the delta unit
+ * to far beyond the 16-bit delta, and feeds the frames byte by byte to the
+ * decoder. Every field must come back: the timestamp exactly from a sync
+ * frame and to within one delta unit from a delta frame. Now and then frames
+ * are dropped, which the decoder must report as lost events and which must
+ * invalidate the time until the next sync frame, or one byte of a frame is
+ * corrupted, which the decoder must reject.
+ *
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bm_sim.h"
+#include "button_matrix_frame.h"
+#include "bm_frame_decode.h"
+
+#define BM_TEST_KEYS            (CFG_ROWS * CFG_COLUMNS)
+#define BM_TEST_DELTA_UNIT      (1UL << BM_FRAME_TIME_SHIFT)
+
+static uint32_t seed = 1;
+static unsigned long failures;
+
+/* xorshift32, so a seed gives the same records on every host */
+static uint32_t bmTest_random(uint32_t range)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    
+    return seed % range;
+}
+
+static void bmTest_fail(unsigned long frame, const char *what)
+{
+    if(failures < 10)
+    {
+        printf("FAIL: frame %lu: %s\n", frame, what);
+    }
+    failures++;
+}
+
+static BUTTON_MATRIX_state_t bmTest_impliedKeys(uint8_t btn1, uint8_t btn2)
+{
+    BUTTON_MATRIX_state_t keys = 0;
+    
+    if(btn1 != 0)
+    {
+        keys |= BUTTON_MATRIX_KEY(btn1);
+    }
+    if(btn2 != 0)
+    {
+        keys |= BUTTON_MATRIX_KEY(btn2);
+    }
+    
+    return keys;
+}
+
+/* A random record, timestamp ticks after the previous one */
+static void bmTest_record(BUTTON_MATRIX_eventRecord_t *record)
+{
+    static const uint32_t steps[] = {BM_TEST_DELTA_UNIT, 0x1000, 0xFFFFUL << BM_FRAME_TIME_SHIFT, 0x10000000UL};
+    
+    record->event = (uint8_t)(ERROR + bmTest_random(SEQUENCE));
+    record->btn1 = (uint8_t)bmTest_random(BM_TEST_KEYS + 1);
+    record->btn2 = (bmTest_random(3) == 0) ? (uint8_t)(1 + bmTest_random(BM_TEST_KEYS)) : BM_NULL_BTN;
+    record->keys = bmTest_impliedKeys(record->btn1, record->btn2);
+    if(bmTest_random(8) == 0)
+    {
+        record->keys |= (BUTTON_MATRIX_state_t)(bmTest_random(1UL << BM_TEST_KEYS));
+    }
+    record->timestamp += bmTest_random(steps[(bmTest_random(64) == 0) ? 3 : bmTest_random(3)]);
+    record->duration = (bmTest_random(2) == 0) ? 0 : (uint16_t)bmTest_random((bmTest_random(2) == 0) ? 0x100 : 0x10000);
+    record->count = (bmTest_random(4) == 0) ? (uint8_t)(1 + bmTest_random(255)) : 0;
+}
+
+/* Payload length, without the CRC, of the frame the record must give */
+static uint8_t bmTest_payloadLength(const BUTTON_MATRIX_eventRecord_t *record, bool sync)
+{
+    uint8_t length = sync ? (7 + sizeof(BUTTON_MATRIX_state_t)) : 5;
+    
+    length += (record->btn2 != 0) ? 1 : 0;
+    length += (record->duration != 0) ? 2 : 0;
+    length += (record->count != 0) ? 1 : 0;
+    
+    return length;
+}
+
+/* Feeds a frame byte by byte; only its delimiter may complete it */
+static bm_decode_result_t bmTest_feed(bm_frame_decoder_t *decoder, const uint8_t *frame, uint8_t length,
+                                      bm_decoded_event_t *event, unsigned long number)
+{
+    bm_decode_result_t result = BM_DECODE_NONE;
+    
+    for(uint8_t i = 0; i < length; i++)
+    {
+        result = bmFrameDecoder_feed(decoder, frame[i], event);
+        if((i + 1 < length) && (result != BM_DECODE_NONE))
+        {
+            bmTest_fail(number, "decoded before its delimiter");
+        }
+    }
+    
+    return result;
+}
+
+/* Flips one bit of a byte before the delimiter, without making it a delimiter */
+static void bmTest_corrupt(uint8_t *frame, uint8_t length)
+{
+    uint8_t index = (uint8_t)bmTest_random(length - 1);
+    uint8_t bit;
+    
+    do
+    {
+        bit = (uint8_t)(1 << bmTest_random(8));
+    } while((frame[index] ^ bit) == BM_FRAME_DELIMITER);
+    frame[index] ^= bit;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n FRAMES] [-s SEED]\n"
+            "  Encodes FRAMES random event records (1000000 by default), decodes them\n"
+            "  and checks every field, with lost and corrupted frames in between.\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    BUTTON_MATRIX_eventRecord_t record = {0};
+    bm_frame_decoder_t decoder;
+    bm_decoded_event_t event;
+    uint8_t frame[BM_FRAME_MAX_SIZE];
+    uint8_t length;
+    uint8_t sequence = 0;
+    uint32_t previousTime = 0;
+    uint32_t delta;
+    unsigned long frames = 1000000;
+    unsigned long sizes[2][BM_FRAME_MAX_SIZE + 1] = {{0}};
+    unsigned long bytes[2] = {0};
+    unsigned long count[2] = {0};
+    unsigned long dropped = 0;
+    unsigned long corrupted = 0;
+    unsigned long rejected = 0;
+    unsigned long unsynced = 0;
+    uint32_t maxError = 0;
+    uint8_t missing = 0;
+    bool timeValid = false;
+    bool sync;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "n:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                if(seed == 0)
+                {
+                    seed = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+    
+    bmFrameDecoder_init(&decoder);
+    /* Start close to the end of the 32-bit RTC time, so it wraps early on */
+    record.timestamp = 0xFFF00000UL;
+    
+    for(unsigned long number = 0; number < frames; number++)
+    {
+        bmTest_record(&record);
+        delta = (record.timestamp - previousTime) >> BM_FRAME_TIME_SHIFT;
+        sync = ((sequence % BM_FRAME_SYNC_INTERVAL) == 0) || (delta > 0xFFFF) ||
+               (record.keys != bmTest_impliedKeys(record.btn1, record.btn2));
+        previousTime = sync ? record.timestamp : (previousTime + (delta << BM_FRAME_TIME_SHIFT));
+        
+        length = BUTTON_MATRIX_encodeFrame(&record, sequence, frame);
+        sequence++;
+        if((length > BM_FRAME_MAX_SIZE) || (frame[length - 1] != BM_FRAME_DELIMITER))
+        {
+            bmTest_fail(number, "frame too long or not delimited");
+            continue;
+        }
+        for(uint8_t i = 0; i + 1 < length; i++)
+        {
+            if(frame[i] == BM_FRAME_DELIMITER)
+            {
+                bmTest_fail(number, "delimiter inside the frame");
+            }
+        }
+        sizes[sync][length]++;
+        bytes[sync] += length;
+        count[sync]++;
+        
+        /* The first frame always arrives, so the lost events of the later ones are known */
+        if((number != 0) && (bmTest_random(256) == 0))
+        {
+            dropped++;
+            missing++;
+            continue;
+        }
+        if((number != 0) && (bmTest_random(128) == 0))
+        {
+            bmTest_corrupt(frame, length);
+            corrupted++;
+            missing++;
+            if(bmTest_feed(&decoder, frame, length, &event, number) == BM_DECODE_BAD_FRAME)
+            {
+                rejected++;
+            }
+            else
+            {
+                bmTest_fail(number, "corrupted frame accepted");
+            }
+            continue;
+        }
+        
+        if(bmTest_feed(&decoder, frame, length, &event, number) != BM_DECODE_EVENT)
+        {
+            bmTest_fail(number, "frame not decoded");
+            missing++;
+            continue;
+        }
+        timeValid = sync || (timeValid && (missing == 0));
+        if((event.event != record.event) || (event.btn1 != record.btn1) || (event.btn2 != record.btn2) ||
+           (event.keys != record.keys) || (event.duration != record.duration) || (event.count != record.count))
+        {
+            bmTest_fail(number, "fields differ");
+        }
+        if((event.sequence != (uint8_t)(sequence - 1)) || (event.lost != missing))
+        {
+            bmTest_fail(number, "wrong sequence or lost count");
+        }
+        if(event.payload_length != bmTest_payloadLength(&record, sync))
+        {
+            bmTest_fail(number, "wrong frame layout");
+        }
+        if(event.time_valid != timeValid)
+        {
+            bmTest_fail(number, "wrong time validity");
+        }
+        else if(timeValid)
+        {
+            /* Exact from a sync frame; a delta frame truncates to its unit, without adding up */
+            if((uint32_t)(record.timestamp - event.timestamp) >= (sync ? 1 : BM_TEST_DELTA_UNIT))
+            {
+                bmTest_fail(number, "wrong timestamp");
+            }
+            else if((record.timestamp - event.timestamp) > maxError)
+            {
+                maxError = record.timestamp - event.timestamp;
+            }
+        }
+        else
+        {
+            unsynced++;
+        }
+        missing = 0;
+    }
+    
+    printf("frames               %10lu, %lu dropped, %lu corrupted\n", frames, dropped, corrupted);
+    for(uint8_t type = 0; type < 2; type++)
+    {
+        printf("%-20s %10lu, %.2f bytes mean, sizes", type ? "sync frames" : "delta frames", count[type],
+               (count[type] != 0) ? ((double)bytes[type] / (double)count[type]) : 0.0);
+        for(uint8_t size = 0; size <= BM_FRAME_MAX_SIZE; size++)
+        {
+            if(sizes[type][size] != 0)
+            {
+                printf(" %u:%lu", size, sizes[type][size]);
+            }
+        }
+        printf("\n");
+    }
+    printf("lost events          %10lu reported by the decoder\n", decoder.lost_events);
+    printf("bad frames           %10lu reported, %lu corrupted frames rejected\n", decoder.bad_frames, rejected);
+    printf("time error           %10u ticks at most, %lu frames without a valid time\n", maxError, unsynced);
+    printf("failures             %10lu\n", failures);
+    
+    if((decoder.lost_events != dropped + corrupted) || (decoder.bad_frames != corrupted))
+    {
+        printf("FAIL: decoder statistics\n");
+        failures++;
+    }
+    
+    return (failures == 0) ? 0 : 1;
+}
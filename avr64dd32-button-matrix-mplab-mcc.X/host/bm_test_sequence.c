@@ -0,0 +1,104 @@
+/**
+ * \file bm_bench.c
+ * \file bm_test_sequence.c
+ *
+ * \brief Host test of the key-sequence recognizer.
+ *
+ * Feeds steps to bmSequence_step and checks which pattern each one completes,
+ * and the time of its first step. Exits with 1 when a case fails.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include "bm_sim.h"
+
+#define K(key)      BUTTON_MATRIX_KEY(key)
+#define STEP_TICKS  BM_TIMER_MS(300)
+
+/* The demo patterns of main.c */
+static const bm_sequence_t demoSequences[] = {
+    {1, 4, {K(1), K(2), K(3), K(4)}},
+    {2, 1, {K(1) | K(4)}},
+    {3, 3, {K(16), K(16), K(13)}},
+};
+
+static const bm_sequence_t overlapSequences[] = {
+    {1, 4, {K(1), K(2), K(1), K(3)}},
+    {2, 2, {K(2), K(4)}},
+};
+
+static unsigned failures;
+
+/*
+ * Feeds the steps 300 ms apart and checks that only the last one completes a
+ * pattern, with id expected and its first step at steps[first]
+ */
+static void bmTest_run(const char *name, const bm_sequence_t *table, uint16_t count,
+                       const BUTTON_MATRIX_state_t *steps, uint8_t length, uint8_t expected, uint8_t first)
+{
+    uint32_t start = 0;
+    uint8_t id;
+    bool pass = true;
+    
+    BUTTON_MATRIX_setSequenceTable(table, count);
+    for(uint8_t i = 0; i < length; i++)
+    {
+        id = bmSequence_step(steps[i], (uint32_t)i * STEP_TICKS, &start);
+        if(i + 1 < length)
+        {
+            pass = pass && (id == BM_SEQUENCE_NO_MATCH);
+        }
+        else
+        {
+            pass = pass && (id == expected) && ((id == BM_SEQUENCE_NO_MATCH) || (start == (uint32_t)first * STEP_TICKS));
+        }
+    }
+    
+    printf("%-40s %s\n", name, pass ? "pass" : "FAIL");
+    if(!pass)
+    {
+        failures++;
+    }
+}
+
+int main(void)
+{
+    static const BUTTON_MATRIX_state_t code[] = {K(1), K(2), K(3), K(4)};
+    static const BUTTON_MATRIX_state_t chord[] = {K(1) | K(4)};
+    static const BUTTON_MATRIX_state_t repeated[] = {K(16), K(16), K(16), K(13)};
+    static const BUTTON_MATRIX_state_t repeatedTwice[] = {K(16), K(16), K(16), K(16), K(16), K(13)};
+    static const BUTTON_MATRIX_state_t interrupted[] = {K(1), K(2), K(16), K(16), K(13)};
+    static const BUTTON_MATRIX_state_t wrong[] = {K(16), K(13)};
+    static const BUTTON_MATRIX_state_t overlap[] = {K(1), K(2), K(1), K(2), K(1), K(3)};
+    static const BUTTON_MATRIX_state_t overlapLonger[] = {K(1), K(2), K(1), K(2), K(1), K(2), K(1), K(3)};
+    static const BUTTON_MATRIX_state_t otherPattern[] = {K(1), K(2), K(4)};
+    
+    bmTest_run("S1 S2 S3 S4", demoSequences, 3, code, 4, 1, 0);
+    bmTest_run("S1+S4", demoSequences, 3, chord, 1, 2, 0);
+    bmTest_run("S16 S16 S16 S13", demoSequences, 3, repeated, 4, 3, 1);
+    bmTest_run("S16 S16 S16 S16 S16 S13", demoSequences, 3, repeatedTwice, 6, 3, 3);
+    bmTest_run("S1 S2 S16 S16 S13", demoSequences, 3, interrupted, 5, 3, 2);
+    bmTest_run("S16 S13", demoSequences, 3, wrong, 2, BM_SEQUENCE_NO_MATCH, 0);
+    bmTest_run("1 2 1 2 1 3 against 1 2 1 3", overlapSequences, 2, overlap, 6, 1, 2);
+    bmTest_run("1 2 1 2 1 2 1 3 against 1 2 1 3", overlapSequences, 2, overlapLonger, 8, 1, 4);
+    bmTest_run("1 2 4 against 1 2 1 3 and 2 4", overlapSequences, 2, otherPattern, 3, 2, 1);
+    
+    return (failures == 0) ? 0 : 1;
+}
@@ -21,25 +21,209 @@
     SOFTWARE.
 */
 
-#include <util/atomic.h>
 #include "mcc_generated_files/system/system.h"
 #include "button_matrix.h"
+#include "sleep_manager.h"
+#if CFG_EVENT_OUTPUT_BINARY
+#include "button_matrix_frame.h"
+#endif
+#if CFG_MAIN_ATOMIC_POLL
+#include <util/atomic.h>
+#endif
+
+/* Number of queued events copied out of the button matrix queue at once */
+#define EVENT_BATCH_SIZE    4
+
+#if CFG_SEQUENCE_RECOGNIZER
+/*
+ * Demo patterns, sorted by their steps: the code S1 S2 S3 S4, the chord S1+S4, and S16 S16 S13
+ * With CFG_KEYMAP the steps are key codes of demoKeymap on layer 0. Its layer
+ * button S15 is never reported, so no pattern may use it.
+ */
+static const bm_sequence_t demoSequences[] BM_FLASH = {
+    {1, 4, {BUTTON_MATRIX_KEY(1), BUTTON_MATRIX_KEY(2), BUTTON_MATRIX_KEY(3), BUTTON_MATRIX_KEY(4)}},
+    {2, 1, {BUTTON_MATRIX_KEY(1) | BUTTON_MATRIX_KEY(4)}},
+    {3, 3, {BUTTON_MATRIX_KEY(16), BUTTON_MATRIX_KEY(16), BUTTON_MATRIX_KEY(13)}},
+};
+#endif
+
+#if CFG_KEYMAP
+/*
+ * Demo keymap: S15 held selects layer 1, where S1 to S14 and S16 report the codes 17 to 31
+ * S15 is the layer button rather than S16, which the third demo pattern uses.
+ */
+static const uint8_t demoKeymap[2][CFG_ROWS * CFG_COLUMNS] BM_FLASH = {
+    { 1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, BM_KEYMAP_MO(1), 16},
+    {17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, BM_KEYMAP_TRANSPARENT, 31},
+};
+#endif
+
+#if CFG_EVENT_OUTPUT_BINARY
+/*
+ * Sends the event as a COBS framed binary record
+ * The sequence number lets the receiver detect dropped events.
+ */
+static void reportEvent(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    static uint8_t sequence = 0;
+    uint8_t frame[BM_FRAME_MAX_SIZE];
+    uint8_t length;
+    
+    length = BUTTON_MATRIX_encodeFrame(record, sequence++, frame);
+    for(uint8_t i = 0; i < length; i++)
+    {
+        USART0_Write(frame[i]);
+    }
+}
+#else
+/* Prints a human readable message for the event, prefixed by its time in seconds */
+static void reportEvent(const BUTTON_MATRIX_eventRecord_t *record)
+{
+    printf("[%lu.%03u] ", (unsigned long)(record->timestamp / BM_TIMER_TICKS_PER_S),
+           (uint16_t)(((record->timestamp % BM_TIMER_TICKS_PER_S) * 1000UL) / BM_TIMER_TICKS_PER_S));
+    
+    switch(record->event)
+    {
+        case ERROR:
+            printf("Too many buttons are pressed at once!\n\r");
+            break;
+        case LONG_PRESS:
+            printf("S%d was pressed for a long time!\n\r", record->btn1);
+            break;
+        case MULTIPLE_SHORT_PRESS:
+            printf("S%d and S%d were pressed for a short time!\n\r", record->btn1, record->btn2);
+            break;
+        case MULTIPLE_LONG_PRESS:
+            printf("S%d and S%d were pressed for a long time!\n\r", record->btn1, record->btn2);
+            break;
+        case SHORT_PRESS:
+            printf("S%d was pressed for a short time!\n\r", record->btn1);
+            break;
+        case PRESS:
+            printf("S%d down\n\r", record->btn1);
+            break;
+        case RELEASE:
+            printf("S%d up after %u ms\n\r", record->btn1, record->duration);
+            break;
+        case REPEAT:
+            printf("S%d repeats\n\r", record->btn1);
+            break;
+        case DOUBLE_TAP:
+            printf("S%d was double-tapped!\n\r", record->btn1);
+            break;
+        case N_TAP:
+            printf("S%d was tapped %d times!\n\r", record->btn1, record->count);
+            break;
+        case SEQUENCE:
+            printf("Sequence %d was entered!\n\r", record->count);
+            break;
+        default:
+            break;
+    }
+}
+#endif
+
+#if CFG_PROFILER && !CFG_EVENT_OUTPUT_BINARY
+/* Prints the cycles spent in each profiled site since the previous report, then starts a new window */
+static void reportProfile(void)
+{
+    static const char * const siteNames[BM_PROFILE_SITES] = {"Scan ISR", "RTC ISR", "Callbacks", "RTC sync"};
+    BUTTON_MATRIX_profile_t profile;
+    
+    for(uint8_t site = 0; site < BM_PROFILE_SITES; site++)
+    {
+        if(BUTTON_MATRIX_getProfile(site, &profile) && (profile.count != 0))
+        {
+            printf("%s: %u runs, %u..%u cycles, mean %lu\n\r", siteNames[site], profile.count, profile.min, profile.max,
+                   (unsigned long)(profile.sum / profile.count));
+        }
+    }
+    BUTTON_MATRIX_resetProfile();
+}
+#endif
+
+#if CFG_SCAN_LATENCY_PROBE && !CFG_EVENT_OUTPUT_BINARY
+/* Prints the smallest and largest scan ISR entry latency each time a new maximum is seen */
+static void reportScanLatency(void)
+{
+    static uint16_t reported_max = 0;
+    uint16_t latency_min, latency_max;
+    
+    BUTTON_MATRIX_getScanLatency(&latency_min, &latency_max);
+    if(latency_max > reported_max)
+    {
+        reported_max = latency_max;
+        printf("Scan ISR entry latency: %u..%u cycles\n\r", latency_min, latency_max);
+    }
+}
+#endif
 
-static volatile BUTTON_MATRIX_event_t event = NONE;
-static volatile uint8_t btn1 = BM_NULL_BTN; 
-static volatile uint8_t btn2 = BM_NULL_BTN;
+#if CFG_MAIN_ATOMIC_POLL
+#if CFG_DEFERRED_DISPATCH
+#error "CFG_MAIN_ATOMIC_POLL needs the callbacks to run in the interrupts"
+#endif
+
+static volatile BUTTON_MATRIX_event_t pollEvent = NONE;
+static volatile uint8_t pollBtn1 = BM_NULL_BTN;
+static volatile uint8_t pollBtn2 = BM_NULL_BTN;
+
+static void atomicPoll_Cb(uint8_t event, uint8_t btn1, uint8_t btn2)
+{
+    pollEvent = event;
+    pollBtn1 = btn1;
+    pollBtn2 = btn2;
+}
 
 /*
- * Event transfer callback
- * This function is used to transfer the event (and the buttons information) 
- * when an event occurs.
+ * The main loop of the original demo, kept to measure the scan ISR latency it
+ * causes: the callback keeps the last event, and every pass of the loop takes
+ * it with the interrupts masked. It never sleeps and never returns.
  */
+static void atomicPollLoop(void)
+{
+    BUTTON_MATRIX_eventRecord_t record;
+    
+    record.keys = 0;
+    record.duration = 0;
+    record.count = 0;
+    BUTTON_MATRIX_setEventCallback(atomicPoll_Cb);
+    
+    while(1)
+    {
+#if CFG_IDLE_WAKEUP
+        BUTTON_MATRIX_Tasks();
+#endif
+        record.event = NONE;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            if(pollEvent != NONE)
+            {
+                record.event = pollEvent;
+                record.btn1 = pollBtn1;
+                record.btn2 = pollBtn2;
+                
+                pollEvent = NONE;
+                pollBtn1 = BM_NULL_BTN;
+                pollBtn2 = BM_NULL_BTN;
+            }
+        }
+        
+        if(record.event != NONE)
+        {
+            record.timestamp = BUTTON_MATRIX_getTime();
+            reportEvent(&record);
+        }
+#if CFG_SCAN_LATENCY_PROBE && !CFG_EVENT_OUTPUT_BINARY
+        reportScanLatency();
+#endif
+    }
+}
+#endif
 
-void MyKeyboardCallback(BUTTON_MATRIX_event_t bm_event, uint8_t bm_btn1, uint8_t bm_btn2)
+/* The main loop may sleep once every event is handled and reported and the last byte has left the USART */
+static bool nothingToDo(void)
 {
-    event = bm_event;
-    btn1 = bm_btn1;
-    btn2 = bm_btn2;
+    return !BUTTON_MATRIX_tasksPending() && !BUTTON_MATRIX_poll() && USART0_IsTxDone();
 }
 
 /*
@@ -48,54 +232,74 @@ void MyKeyboardCallback(BUTTON_MATRIX_event_t bm_event, uint8_t bm_btn1, uint8_t
 
 int main(void)
 {
-    BUTTON_MATRIX_event_t temp_event = NONE;
-    uint8_t temp_btn1 = BM_NULL_BTN; 
-    uint8_t temp_btn2 = BM_NULL_BTN;
+    BUTTON_MATRIX_eventRecord_t events[EVENT_BATCH_SIZE];
+    uint8_t count;
+#if !CFG_EVENT_OUTPUT_BINARY
+    uint16_t dropped = 0;
+#endif
+#if CFG_SLEEP_STATS && !CFG_EVENT_OUTPUT_BINARY
+    uint8_t asleep_percent;
+#endif
+#if CFG_PROFILER && !CFG_EVENT_OUTPUT_BINARY
+    uint32_t profile_time = 0;
+#endif
     
     SYSTEM_Initialize();
-    BUTTON_MATRIX_setEventCallback(MyKeyboardCallback);
+#if CFG_SEQUENCE_RECOGNIZER
+    if(!BUTTON_MATRIX_setSequenceTable(demoSequences, sizeof(demoSequences) / sizeof(demoSequences[0])))
+    {
+        printf("The sequence table is not sorted\n\r");
+    }
+#endif
+#if CFG_KEYMAP
+    BUTTON_MATRIX_setKeymap(&demoKeymap[0][0], 2);
+#endif
     BUTTON_MATRIX_init();
-    
+    SLEEP_MANAGER_init();
+#if CFG_MAIN_ATOMIC_POLL
+    atomicPollLoop();
+#endif
     
     while(1)
     {
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        BUTTON_MATRIX_Tasks();
+        count = BUTTON_MATRIX_readEvents(events, EVENT_BATCH_SIZE);
+        
+        for(uint8_t i = 0; i < count; i++)
         {
-            if(event != NONE)
-            {
-                temp_event = event;
-                temp_btn1 = btn1; 
-                temp_btn2 = btn2;
-                
-                event = NONE;
-                btn1 = BM_NULL_BTN; 
-                btn2 = BM_NULL_BTN;
-            }
+            reportEvent(&events[i]);
         }
-        switch(temp_event)
+        
+        /* In binary mode only frames are sent; dropped events show up as gaps in the sequence numbers */
+#if !CFG_EVENT_OUTPUT_BINARY
+        if(dropped != BUTTON_MATRIX_getDroppedEvents())
+        {
+            dropped = BUTTON_MATRIX_getDroppedEvents();
+            printf("%u events were dropped (queue high-water mark: %d)\n\r", dropped, BUTTON_MATRIX_getQueueHighWater());
+        }
+#endif
+        
+#if CFG_SCAN_LATENCY_PROBE && !CFG_EVENT_OUTPUT_BINARY
+        reportScanLatency();
+#endif
+        
+#if CFG_SLEEP_STATS && !CFG_EVENT_OUTPUT_BINARY
+        if(SLEEP_MANAGER_getAsleepPercent(&asleep_percent))
+        {
+            printf("Asleep %d%% of the time\n\r", asleep_percent);
+        }
+#endif
+        
+#if CFG_PROFILER && !CFG_EVENT_OUTPUT_BINARY
+        /* The loop only runs when it wakes up, so a report may come later while the keys are idle */
+        if((BUTTON_MATRIX_getTime() - profile_time) >= BM_TIMER_MS(CFG_PROFILER_DUMP_S * 1000UL))
         {
-            case ERROR:
-                printf("Too many buttons are pressed at once!\n\r");
-                break;
-            case LONG_PRESS:
-                printf("S%d was pressed for a long time!\n\r", temp_btn1);
-                break;
-            case MULTIPLE_SHORT_PRESS:
-                printf("S%d and S%d were pressed for a short time!\n\r", temp_btn1, temp_btn2);
-                break;
-            case MULTIPLE_LONG_PRESS:
-                printf("S%d and S%d were pressed for a long time!\n\r", temp_btn1, temp_btn2);
-                break;
-            case SHORT_PRESS:
-                printf("S%d was pressed for a short time!\n\r", temp_btn1);
-                break;
-            default:
-                break;
+            profile_time = BUTTON_MATRIX_getTime();
+            reportProfile();
         }
+#endif
         
-        temp_event = NONE;
-        temp_btn1 = BM_NULL_BTN; 
-        temp_btn2 = BM_NULL_BTN;
+        SLEEP_MANAGER_sleep(nothingToDo);
     }
 }
 
@@ -95,8 +95,10 @@ void RTC_SetPITIsrCallback(RTC_cb_t cb)
 
 ISR(RTC_CNT_vect)
 {
+    /* Each flag is cleared before its callback, so a match during the callback is not lost */
     if (RTC.INTFLAGS & RTC_OVF_bm )
     {
+        RTC.INTFLAGS = RTC_OVF_bm;
         if (RTC_OVF_isr_cb != NULL) 
         {
             (*RTC_OVF_isr_cb)();
@@ -105,12 +107,12 @@ ISR(RTC_CNT_vect)
     
     if (RTC.INTFLAGS & RTC_CMP_bm )
     {
+        RTC.INTFLAGS = RTC_CMP_bm;
         if (RTC_CMP_isr_cb != NULL) 
         {
             (*RTC_CMP_isr_cb)();
         } 
     }  
-    RTC.INTFLAGS = (RTC_OVF_bm | RTC_CMP_bm);
 }
 
 ISR(RTC_PIT_vect)
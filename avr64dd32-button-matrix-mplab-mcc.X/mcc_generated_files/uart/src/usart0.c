@@ -64,7 +64,7 @@ const uart_drv_interface_t UART0 = {
     .BaudSet = NULL,
     .BaudGet = NULL,
     .ErrorGet = &USART0_ErrorGet,
-    .TxCompleteCallbackRegister = NULL,
+    .TxCompleteCallbackRegister = &USART0_TxCompleteCallbackRegister,
     .RxCompleteCallbackRegister = NULL,
     .TxCollisionCallbackRegister = NULL,
     .FramingErrorCallbackRegister = &USART0_FramingErrorCallbackRegister,
@@ -77,6 +77,11 @@ const uart_drv_interface_t UART0 = {
   Section: USART0 variables
 */
 static volatile usart0_status_t usart0RxLastError;
+static volatile uint8_t usart0TxBuffer[USART0_TX_BUFFER_SIZE];
+static volatile uint8_t usart0TxHead;      /* written by USART0_Write only */
+static volatile uint8_t usart0TxTail;      /* written by the DRE interrupt (and by a drop-oldest overflow) */
+static volatile uint16_t usart0TxDropped;
+static volatile bool usart0TxStarted;     /* TXCIF is only meaningful once a byte has been sent */
 
 /**
   Section: USART0 APIs
@@ -84,6 +89,7 @@ static volatile usart0_status_t usart0RxLastError;
 void (*USART0_FramingErrorHandler)(void);
 void (*USART0_OverrunErrorHandler)(void);
 void (*USART0_ParityErrorHandler)(void);
+void (*USART0_TxCompleteHandler)(void);
 
 static void USART0_DefaultFramingErrorCallback(void);
 static void USART0_DefaultOverrunErrorCallback(void);
@@ -99,7 +105,6 @@ static void USART0_DefaultParityErrorCallback(void);
 
 int USART0_printCHAR(char character, FILE *stream)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(character);
     return 0;
 }
@@ -110,7 +115,6 @@ FILE USART0_stream = FDEV_SETUP_STREAM(USART0_printCHAR, NULL, _FDEV_SETUP_WRITE
 
 int putchar (int outChar)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(outChar);
     return outChar;
 }
@@ -148,6 +152,11 @@ void USART0_Initialize(void)
     USART0_OverrunErrorCallbackRegister(USART0_DefaultOverrunErrorCallback);
     USART0_ParityErrorCallbackRegister(USART0_DefaultParityErrorCallback);
     usart0RxLastError.status = 0;  
+    usart0TxHead = 0;
+    usart0TxTail = 0;
+    usart0TxDropped = 0;
+    usart0TxStarted = false;
+    USART0_TxCompleteHandler = NULL;
 #if defined(__GNUC__)
     stdout = &USART0_stream;
 #endif
@@ -202,12 +211,22 @@ bool USART0_IsRxReady(void)
 
 bool USART0_IsTxReady(void)
 {
-    return (bool)(USART0.STATUS & USART_DREIF_bm);
+    return (uint8_t)(usart0TxHead - usart0TxTail) < USART0_TX_BUFFER_SIZE;
 }
 
 bool USART0_IsTxDone(void)
 {
-    return (bool)(USART0.STATUS & USART_TXCIF_bm);
+    return (usart0TxHead == usart0TxTail) && (!usart0TxStarted || (USART0.STATUS & USART_TXCIF_bm));
+}
+
+uint8_t USART0_TxBufferCountGet(void)
+{
+    return (uint8_t)(usart0TxHead - usart0TxTail);
+}
+
+uint16_t USART0_TxDroppedCountGet(void)
+{
+    return usart0TxDropped;
 }
 
 size_t USART0_ErrorGet(void)
@@ -247,9 +266,72 @@ uint8_t USART0_Read(void)
 }
 
 
+/* Moves one buffered byte to the data register; used by the DRE interrupt and when waiting with interrupts disabled */
+static void USART0_TxSendNext(void)
+{
+    uint8_t tail = usart0TxTail;
+
+    USART0.STATUS = USART_TXCIF_bm;    // Clear the transmit complete flag, USART0_IsTxDone() waits for the new byte.
+    USART0.TXDATAL = usart0TxBuffer[tail & (USART0_TX_BUFFER_SIZE - 1U)];
+    usart0TxTail = tail + 1U;
+    usart0TxStarted = true;
+}
+
 void USART0_Write(uint8_t txData)
 {
-    USART0.TXDATAL = txData;    // Write the data byte to the USART.
+    uint8_t head = usart0TxHead;
+
+    if((uint8_t)(head - usart0TxTail) >= USART0_TX_BUFFER_SIZE)
+    {
+#if (USART0_TX_OVERFLOW_POLICY == USART0_TX_OVERFLOW_BLOCK)
+        while((uint8_t)(head - usart0TxTail) >= USART0_TX_BUFFER_SIZE)
+        {
+            // The DRE interrupt cannot run (e.g. printf called from an ISR), so drain the buffer by polling.
+            if(!(SREG & CPU_I_bm) && (USART0.STATUS & USART_DREIF_bm))
+            {
+                USART0_TxSendNext();
+            }
+        }
+#elif (USART0_TX_OVERFLOW_POLICY == USART0_TX_OVERFLOW_DROP_NEWEST)
+        if(usart0TxDropped != UINT16_MAX)
+        {
+            usart0TxDropped++;
+        }
+        return;
+#else
+        // Hold off the DRE interrupt while the oldest byte is discarded, it also writes the tail index.
+        USART0.CTRLA &= ~USART_DREIE_bm;
+        if((uint8_t)(head - usart0TxTail) >= USART0_TX_BUFFER_SIZE)
+        {
+            usart0TxTail++;
+            if(usart0TxDropped != UINT16_MAX)
+            {
+                usart0TxDropped++;
+            }
+        }
+#endif
+    }
+
+    usart0TxBuffer[head & (USART0_TX_BUFFER_SIZE - 1U)] = txData;
+    usart0TxHead = head + 1U;
+    USART0.CTRLA |= USART_DREIE_bm;    // Start (or keep) the interrupt driven transfer.
+}
+
+ISR(USART0_DRE_vect)
+{
+    if(usart0TxHead != usart0TxTail)
+    {
+        USART0_TxSendNext();
+    }
+
+    if(usart0TxHead == usart0TxTail)
+    {
+        USART0.CTRLA &= ~USART_DREIE_bm;
+        if(NULL != USART0_TxCompleteHandler)
+        {
+            USART0_TxCompleteHandler();
+        }
+    }
 }
 static void USART0_DefaultFramingErrorCallback(void)
 {
@@ -290,6 +372,11 @@ void USART0_ParityErrorCallbackRegister(void (* callbackHandler)(void))
     } 
 }
 
+void USART0_TxCompleteCallbackRegister(void (* callbackHandler)(void))
+{
+    USART0_TxCompleteHandler = callbackHandler;
+}
+
 
 
 
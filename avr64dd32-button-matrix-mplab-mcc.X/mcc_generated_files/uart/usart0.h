@@ -54,6 +54,20 @@
 
 #define UART0_interface UART0
 
+/* Transmit buffer size in bytes, must be a power of two no larger than 128 */
+#define USART0_TX_BUFFER_SIZE           (64U)
+
+/* Transmit buffer overflow policies */
+#define USART0_TX_OVERFLOW_BLOCK        (0U)    /**<Wait for free space*/
+#define USART0_TX_OVERFLOW_DROP_NEWEST  (1U)    /**<Discard the byte being written*/
+#define USART0_TX_OVERFLOW_DROP_OLDEST  (2U)    /**<Discard the oldest buffered byte*/
+
+#define USART0_TX_OVERFLOW_POLICY       USART0_TX_OVERFLOW_BLOCK
+
+#if ((USART0_TX_BUFFER_SIZE & (USART0_TX_BUFFER_SIZE - 1U)) != 0U) || (USART0_TX_BUFFER_SIZE > 128U)
+#error "USART0_TX_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
 
 #define UART0_Initialize     USART0_Initialize
 #define UART0_Deinitialize   USART0_Deinitialize
@@ -73,7 +87,7 @@
 #define UART0_BaudGet              (NULL)
 #define UART0_ErrorGet             USART0_ErrorGet
 
-#define UART0_TxCompleteCallbackRegister     (NULL)
+#define UART0_TxCompleteCallbackRegister     USART0_TxCompleteCallbackRegister
 #define UART0_RxCompleteCallbackRegister      (NULL)
 #define UART0_TxCollisionCallbackRegister  (NULL)
 #define UART0_FramingErrorCallbackRegister USART0_FramingErrorCallbackRegister
@@ -194,11 +208,27 @@ bool USART0_IsRxReady(void);
  * @ingroup usart0
  * @brief This function checks if USART0 transmitter is ready to accept a data byte.
  * @param None.
- * @retval true if USART0 transmitter FIFO has atleast 1 byte space
- * @retval false if USART0 transmitter FIFO is full
+ * @retval true if USART0 transmit buffer has atleast 1 byte space
+ * @retval false if USART0 transmit buffer is full
  */
 bool USART0_IsTxReady(void);
 
+/**
+ * @ingroup usart0
+ * @brief This function returns the number of bytes waiting in the transmit buffer.
+ * @param None.
+ * @return Number of buffered bytes not yet moved to the USART0 data register.
+ */
+uint8_t USART0_TxBufferCountGet(void);
+
+/**
+ * @ingroup usart0
+ * @brief This function returns the number of bytes discarded because the transmit buffer was full.
+ * @param None.
+ * @return Dropped byte count, saturating at 0xFFFF.
+ */
+uint16_t USART0_TxDroppedCountGet(void);
+
 /**
  * @ingroup usart0
  * @brief This function return the status of transmit shift register (TSR).
@@ -229,9 +259,10 @@ uint8_t USART0_Read(void);
 
 /**
  * @ingroup usart0
- * @brief This function writes a byte of data to the transmitter FIFO register.
- * @pre The transfer status should be checked to see if the transmitter is ready to accept a byte
- *      before calling this function. USART0_IsTxReady() should be checked in if() before calling this API.
+ * @brief This function queues a byte of data in the transmit buffer.
+ *        The Data Register Empty interrupt moves it to the TX FIFO register.
+ *        When the buffer is full, USART0_TX_OVERFLOW_POLICY selects whether the call waits,
+ *        discards txData or discards the oldest buffered byte.
  * @param txData  - Data byte to write to the TX FIFO.
  * @return None.
  */
@@ -261,6 +292,15 @@ void USART0_OverrunErrorCallbackRegister(void (* callbackHandler)(void));
  */
 void USART0_ParityErrorCallbackRegister(void (* callbackHandler)(void));
 
+/**
+ * @ingroup usart0
+ * @brief This API registers the function to be called when the transmit buffer has been emptied.
+ *        The callback runs in interrupt context.
+ * @param callbackHandler - a function pointer which will be called when the last buffered byte is moved to the TX FIFO.
+ * @return None.
+ */
+void USART0_TxCompleteCallbackRegister(void (* callbackHandler)(void));
+
 
 #ifdef __cplusplus  // Provide C++ Compatibility
 
@@ -0,0 +1,144 @@
+/**
+ * \file sleep_manager.c
+ *
+ * \brief Main loop sleep between events.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "mcc_generated_files/system/system.h"
+#include "sleep_manager.h"
+
+#if CFG_SLEEP_STATS
+static volatile bool asleep;
+static uint16_t windowSamples;
+static uint16_t windowAsleep;
+static volatile uint8_t asleepPercent;
+static volatile uint8_t windowCount;
+static uint8_t windowCountSeen;
+
+/*
+ * Called by the RTC periodic interrupt, which runs from the 32 kHz oscillator
+ * and is not synchronized with the CPU activity, so the share of samples that
+ * find the CPU asleep estimates the share of time spent asleep
+ */
+static void sleepStats_sample(void)
+{
+    if(asleep)
+    {
+        windowAsleep++;
+    }
+    windowSamples++;
+    
+    if(windowSamples >= SLEEP_STATS_WINDOW)
+    {
+        asleepPercent = (uint8_t)(((uint32_t)windowAsleep * 100U) / SLEEP_STATS_WINDOW);
+        windowCount++;
+        windowSamples = 0;
+        windowAsleep = 0;
+    }
+}
+
+static void sleepStats_init(void)
+{
+    asleep = false;
+    windowSamples = 0;
+    windowAsleep = 0;
+    asleepPercent = 0;
+    windowCount = 0;
+    windowCountSeen = 0;
+    
+    while(RTC.PITSTATUS & RTC_CTRLBUSY_bm)
+    {
+        ;
+    }
+    RTC.PITCTRLA = CFG_SLEEP_STATS_PERIOD | RTC_PITEN_bm;
+    RTC_SetPITIsrCallback(sleepStats_sample);
+    RTC_EnablePITInterrupt();
+}
+
+/* Returns true and the asleep share of the last window when a new window has completed */
+bool SLEEP_MANAGER_getAsleepPercent(uint8_t *percent)
+{
+    uint8_t count = windowCount;
+    
+    if(count == windowCountSeen)
+    {
+        return false;
+    }
+    
+    windowCountSeen = count;
+    *percent = asleepPercent;
+    
+    return true;
+}
+#endif
+
+/*
+ * Selects the sleep mode; in standby the scan timer and the RTC must be told
+ * to keep running, so scanning and long-press timing go on while asleep
+ */
+void SLEEP_MANAGER_init(void)
+{
+#if CFG_MAIN_SLEEP_MODE == SLEEP_MODE_STANDBY
+    TCA0.SINGLE.CTRLA |= TCA_SINGLE_RUNSTDBY_bm;
+    while(RTC.STATUS & RTC_CTRLABUSY_bm)
+    {
+        ;
+    }
+    RTC.CTRLA |= RTC_RUNSTDBY_bm;
+    SLPCTRL.CTRLA = SLPCTRL_SMODE_STDBY_gc;
+#elif CFG_MAIN_SLEEP_MODE == SLEEP_MODE_IDLE
+    SLPCTRL.CTRLA = SLPCTRL_SMODE_IDLE_gc;
+#endif
+#if CFG_SLEEP_STATS
+    sleepStats_init();
+#endif
+}
+
+/*
+ * Sleeps until the next interrupt if can_sleep() returns true
+ * The condition is checked with interrupts disabled, and SEI takes effect only
+ * after the following SLEEP instruction, so an interrupt that makes the
+ * condition false cannot slip in between the check and the sleep.
+ */
+void SLEEP_MANAGER_sleep(sleep_condition_t can_sleep)
+{
+#if CFG_MAIN_SLEEP_MODE != SLEEP_MODE_NONE
+    cli();
+    if(!can_sleep())
+    {
+        sei();
+        return;
+    }
+    
+#if CFG_SLEEP_STATS
+    asleep = true;
+#endif
+    SLPCTRL.CTRLA |= SLPCTRL_SEN_bm;
+    sei();
+    sleep_cpu();
+    SLPCTRL.CTRLA &= ~SLPCTRL_SEN_bm;
+#if CFG_SLEEP_STATS
+    asleep = false;
+#endif
+#endif
+}
@@ -0,0 +1,57 @@
+/**
+ * \file sleep_manager.h
+ *
+ * \brief Main loop sleep between events.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef SLEEP_MANAGER_H
+#define	SLEEP_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_config.h"
+
+/* Values for CFG_MAIN_SLEEP_MODE */
+#define SLEEP_MODE_NONE         0    /* the main loop never sleeps */
+#define SLEEP_MODE_IDLE         1    /* CPU stopped, peripheral clocks running */
+#define SLEEP_MODE_STANDBY      2    /* only peripherals set to run in standby keep running */
+
+/* Number of PIT samples over which the asleep fraction is measured */
+#define SLEEP_STATS_WINDOW      256U
+
+typedef bool (*sleep_condition_t)(void);
+
+void SLEEP_MANAGER_init(void);
+void SLEEP_MANAGER_sleep(sleep_condition_t can_sleep);
+
+#if CFG_SLEEP_STATS
+bool SLEEP_MANAGER_getAsleepPercent(uint8_t *percent);
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef	__cplusplus
+}
+#endif /* __cplusplus */
+
+#endif	/* SLEEP_MANAGER_H */
@@ -0,0 +1,193 @@
+/**
+ * \file bm_decode.c
+ *
+ * \brief Command line decoder for the button matrix binary event stream.
+ *
+ * Reads COBS framed events from a file, a pty or a serial device (or stdin)
+ * and prints one line per event, followed by frame statistics at the end.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "bm_frame_decode.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int signal)
+{
+    (void)signal;
+    stop = 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-q] [FILE|DEVICE]\n"
+            "  Decodes button matrix event frames from FILE, a pty or serial DEVICE\n"
+            "  (configured as 115200 8N1 raw), or stdin when no path is given.\n"
+            "  -q  print only the statistics\n", name);
+}
+
+/* Puts a serial port or pty into raw 115200 8N1 mode; regular files are left alone */
+static void configureTty(int fd)
+{
+    struct termios tty;
+
+    if(!isatty(fd) || (tcgetattr(fd, &tty) != 0))
+    {
+        return;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B115200);
+    cfsetospeed(&tty, B115200);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tty);
+}
+
+static void printEvent(const bm_decoded_event_t *event)
+{
+    if(event->lost != 0)
+    {
+        printf("(%u events lost)\n", event->lost);
+    }
+    if(event->time_valid)
+    {
+        printf("%10.4f ", event->timestamp / 32768.0);
+    }
+    else
+    {
+        printf("%10s ", "?");
+    }
+    printf("#%03u %-20s", event->sequence, bmFrame_eventName(event->event));
+    if(event->btn1 != 0)
+    {
+        printf(" S%u", event->btn1);
+    }
+    if(event->btn2 != 0)
+    {
+        printf(" S%u", event->btn2);
+    }
+    /* btn1 and btn2 only name two buttons; list the chord when it has more */
+    if(__builtin_popcount(event->keys) > 2)
+    {
+        printf(" [");
+        for(unsigned i = 0; i < 32; i++)
+        {
+            if(event->keys & (1UL << i))
+            {
+                printf(" S%u", i + 1);
+            }
+        }
+        printf(" ]");
+    }
+    if(event->count != 0)
+    {
+        printf(" x%u", event->count);
+    }
+    if(event->duration != 0)
+    {
+        printf(" (%u ms)", event->duration);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    bm_frame_decoder_t decoder;
+    bm_decoded_event_t event;
+    unsigned char chunk[256];
+    bool quiet = false;
+    int fd = STDIN_FILENO;
+    int opt;
+    ssize_t received;
+
+    while((opt = getopt(argc, argv, "qh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if(optind < argc)
+    {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if(fd < 0)
+        {
+            fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    configureTty(fd);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    bmFrameDecoder_init(&decoder);
+
+    while(!stop)
+    {
+        received = read(fd, chunk, sizeof(chunk));
+        if(received < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            perror("read");
+            break;
+        }
+        if(received == 0)
+        {
+            break;
+        }
+
+        for(ssize_t i = 0; i < received; i++)
+        {
+            if((bmFrameDecoder_feed(&decoder, chunk[i], &event) == BM_DECODE_EVENT) && !quiet)
+            {
+                printEvent(&event);
+            }
+        }
+        fflush(stdout);
+    }
+
+    printf("frames: %lu, bad frames: %lu, lost events: %lu\n",
+           decoder.frames, decoder.bad_frames, decoder.lost_events);
+
+    if(fd != STDIN_FILENO)
+    {
+        close(fd);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/**
+ * \file bm_frame_decode.c
+ *
+ * \brief Host-side decoder for the button matrix binary event frames.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#include "bm_frame_decode.h"
+
+/* Same order as BUTTON_MATRIX_event_t in button_matrix.h */
+static const char *const eventNames[] = {
+    "NONE",
+    "ERROR",
+    "SHORT_PRESS",
+    "LONG_PRESS",
+    "MULTIPLE_SHORT_PRESS",
+    "MULTIPLE_LONG_PRESS",
+    "PRESS",
+    "RELEASE",
+    "REPEAT",
+    "DOUBLE_TAP",
+    "N_TAP",
+    "SEQUENCE"
+};
+
+const char *bmFrame_eventName(uint8_t event)
+{
+    if(event < sizeof(eventNames) / sizeof(eventNames[0]))
+    {
+        return eventNames[event];
+    }
+    return "UNKNOWN";
+}
+
+void bmFrameDecoder_init(bm_frame_decoder_t *decoder)
+{
+    decoder->length = 0;
+    decoder->overflow = false;
+    decoder->synced = false;
+    decoder->next_sequence = 0;
+    decoder->time_valid = false;
+    decoder->time = 0;
+    decoder->frames = 0;
+    decoder->bad_frames = 0;
+    decoder->lost_events = 0;
+}
+
+/* Reverses bmFrame_cobsEncode; returns the decoded length or 0 if the input is not valid COBS */
+uint8_t bmFrame_cobsDecode(const uint8_t *source, uint8_t length, uint8_t *destination)
+{
+    uint8_t read_index = 0;
+    uint8_t write_index = 0;
+    uint8_t code;
+
+    while(read_index < length)
+    {
+        code = source[read_index];
+        if((code == 0) || ((uint16_t)read_index + code > length))
+        {
+            return 0;
+        }
+        read_index++;
+
+        for(uint8_t i = 1; i < code; i++)
+        {
+            destination[write_index++] = source[read_index++];
+        }
+        if((code != 0xFF) && (read_index != length))
+        {
+            destination[write_index++] = 0;
+        }
+    }
+
+    return write_index;
+}
+
+/* Reads a little endian field of size bytes (up to 4) */
+static uint32_t readLe(const uint8_t *data, uint8_t size)
+{
+    uint32_t value = 0;
+
+    while(size-- > 0)
+    {
+        value = (value << 8) | data[size];
+    }
+    return value;
+}
+
+static bm_decode_result_t decodeFrame(bm_frame_decoder_t *decoder, bm_decoded_event_t *event)
+{
+    uint8_t raw[BM_FRAME_MAX_SIZE];
+    uint8_t length;
+    uint8_t index = 3;
+    uint8_t flags;
+    uint8_t crc = 0;
+
+    length = bmFrame_cobsDecode(decoder->buffer, decoder->length, raw);
+    if((length < BM_FRAME_PAYLOAD_MIN_SIZE + 1) || (length > BM_FRAME_RAW_SIZE))
+    {
+        return BM_DECODE_BAD_FRAME;
+    }
+    length--;
+
+    for(uint8_t i = 0; i < length; i++)
+    {
+        crc = bmFrame_crc8(crc, raw[i]);
+    }
+    if(crc != raw[length])
+    {
+        return BM_DECODE_BAD_FRAME;
+    }
+
+    /* The flags give the optional fields; whatever is left of a sync frame is the keys bitmap */
+    flags = raw[0];
+    event->event = flags & BM_FRAME_EVENT_MASK;
+    event->btn1 = raw[1];
+    event->btn2 = 0;
+    event->sequence = raw[2];
+    event->payload_length = length;
+    event->duration = 0;
+    event->count = 0;
+    index += (flags & BM_FRAME_FLAG_SYNC) ? 4 : 2;
+    if(flags & BM_FRAME_FLAG_BTN2)
+    {
+        event->btn2 = raw[index++];
+    }
+    if(flags & BM_FRAME_FLAG_DURATION)
+    {
+        event->duration = (uint16_t)readLe(&raw[index], 2);
+        index += 2;
+    }
+    if(flags & BM_FRAME_FLAG_COUNT)
+    {
+        event->count = raw[index++];
+    }
+    if((index > length) || ((length - index) > 4) || (!(flags & BM_FRAME_FLAG_SYNC) && (index != length)))
+    {
+        return BM_DECODE_BAD_FRAME;
+    }
+
+    event->lost = decoder->synced ? (uint8_t)(event->sequence - decoder->next_sequence) : 0;
+    if(flags & BM_FRAME_FLAG_SYNC)
+    {
+        event->keys = readLe(&raw[index], (uint8_t)(length - index));
+        decoder->time = readLe(&raw[3], 4);
+        decoder->time_valid = true;
+    }
+    else
+    {
+        /* A lost frame takes its time delta with it */
+        event->keys = 0;
+        if(event->btn1 != 0)
+        {
+            event->keys |= 1UL << ((event->btn1 - 1) & 31);
+        }
+        if(event->btn2 != 0)
+        {
+            event->keys |= 1UL << ((event->btn2 - 1) & 31);
+        }
+        decoder->time += readLe(&raw[3], 2) << BM_FRAME_TIME_SHIFT;
+        decoder->time_valid = decoder->time_valid && (event->lost == 0);
+    }
+    event->timestamp = decoder->time;
+    event->time_valid = decoder->time_valid;
+
+    decoder->synced = true;
+    decoder->next_sequence = (uint8_t)(event->sequence + 1);
+    decoder->lost_events += event->lost;
+
+    return BM_DECODE_EVENT;
+}
+
+/* Feeds one received byte; a complete frame is reported when its delimiter arrives */
+bm_decode_result_t bmFrameDecoder_feed(bm_frame_decoder_t *decoder, uint8_t byte, bm_decoded_event_t *event)
+{
+    bm_decode_result_t result;
+
+    if(byte != BM_FRAME_DELIMITER)
+    {
+        if(decoder->length < sizeof(decoder->buffer))
+        {
+            decoder->buffer[decoder->length++] = byte;
+        }
+        else
+        {
+            decoder->overflow = true;
+        }
+        return BM_DECODE_NONE;
+    }
+
+    if((decoder->length == 0) && !decoder->overflow)
+    {
+        return BM_DECODE_NONE;
+    }
+
+    result = decoder->overflow ? BM_DECODE_BAD_FRAME : decodeFrame(decoder, event);
+    decoder->length = 0;
+    decoder->overflow = false;
+
+    if(result == BM_DECODE_EVENT)
+    {
+        decoder->frames++;
+    }
+    else
+    {
+        decoder->bad_frames++;
+    }
+
+    return result;
+}
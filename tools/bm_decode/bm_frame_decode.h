@@ -0,0 +1,70 @@
+/**
+ * \file bm_frame_decode.h
+ *
+ * \brief Host-side decoder for the button matrix binary event frames.
+ *
+ (c) 2021 Microchip Technology Inc. and its subsidiaries.
+    Subject to your compliance with these terms, you may use this software and
+    any derivatives exclusively with Microchip products. It is your responsibility
+    to comply with third party license terms applicable to your use of third party
+    software (including open source software) that may accompany Microchip software.
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+    WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+    PARTICULAR PURPOSE.
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+    BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+    FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS IN
+    ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+    THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ */
+
+#ifndef BM_FRAME_DECODE_H
+#define	BM_FRAME_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "button_matrix_frame.h"
+
+typedef enum {
+    BM_DECODE_NONE,         /* byte consumed, no complete frame yet */
+    BM_DECODE_EVENT,        /* a valid frame was decoded */
+    BM_DECODE_BAD_FRAME     /* a frame was dropped (COBS, length or CRC error) */
+} bm_decode_result_t;
+
+typedef struct {
+    uint8_t event;
+    uint8_t btn1;
+    uint8_t btn2;
+    uint8_t sequence;
+    uint8_t lost;           /* events missing before this one, from the sequence gap */
+    uint8_t payload_length; /* payload bytes, without the CRC */
+    bool time_valid;        /* false until a sync frame has set the time base */
+    uint32_t keys;          /* every button of the chord, bit (button - 1) */
+    uint32_t timestamp;     /* RTC ticks (1/32768 s), to the BM_FRAME_TIME_SHIFT unit of delta frames */
+    uint16_t duration;      /* ms the chord was held */
+    uint8_t count;          /* taps of a multi-tap sequence */
+} bm_decoded_event_t;
+
+typedef struct {
+    uint8_t buffer[BM_FRAME_MAX_SIZE];
+    uint8_t length;
+    bool overflow;
+    bool synced;            /* false until the first valid frame */
+    uint8_t next_sequence;
+    bool time_valid;        /* false until a sync frame, and again after a lost frame */
+    uint32_t time;          /* RTC time of the last frame */
+    unsigned long frames;
+    unsigned long bad_frames;
+    unsigned long lost_events;
+} bm_frame_decoder_t;
+
+void bmFrameDecoder_init(bm_frame_decoder_t *decoder);
+bm_decode_result_t bmFrameDecoder_feed(bm_frame_decoder_t *decoder, uint8_t byte, bm_decoded_event_t *event);
+uint8_t bmFrame_cobsDecode(const uint8_t *source, uint8_t length, uint8_t *destination);
+const char *bmFrame_eventName(uint8_t event);
+
+#endif	/* BM_FRAME_DECODE_H */